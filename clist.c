@@ -8,418 +8,2279 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
 #include <assert.h>
 #include <string.h>
+#include <sys/mman.h>
 
 #include "clist.h"
+#include "clist_internal.h"
 
-#define DEBUG
+// Enough bins for CL_sort to sort any list whose length fits in a size_t
+#define CL_SORT_BINS (8 * sizeof(size_t) + 1)
 
-struct _cl_node
+// CL_sort_parallel gives no thread a run shorter than this
+#define CL_SORT_MIN_RUN 1024
+
+// CL_parallel_foreach cuts a list into this many segments per thread,
+// so that threads that finish early can steal the remaining segments
+#define CL_SEGMENTS_PER_THREAD 8
+
+// A node of an owning list, allocated together with a copy of its
+// element, so the string sits right after the links it is reached by
+struct _cl_owned_node
+{
+  struct _cl_node node;
+  char data[];
+};
+
+#ifdef CL_STATS
+/*
+ * Add n to one of a list's counters. A list with a concurrent backend
+ * may be counting in several threads at once.
+ */
+static inline void
+_CL_stat_add(CList list, size_t *counter, size_t n)
+{
+  if (list->ops != NULL && list->ops->concurrent)
+    __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+  else
+    *counter += n;
+}
+
+/*
+ * Record a list's length as its peak length if it is the longest yet
+ */
+static inline void
+_CL_stat_peak(CList list)
+{
+  if (list->ops != NULL && list->ops->concurrent)
+  {
+    size_t length = (size_t)__atomic_load_n(&list->length, __ATOMIC_RELAXED);
+    size_t peak = __atomic_load_n(&list->stats.peak_length, __ATOMIC_RELAXED);
+    while (length > peak && !__atomic_compare_exchange_n(&list->stats.peak_length, &peak, length, true,
+                                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      ;
+  }
+  else if ((size_t)list->length > list->stats.peak_length)
+    list->stats.peak_length = list->length;
+}
+
+// Count a call to a public function. Searches on the linked backend
+// are charged to the function most recently called on the list.
+#define CL_STAT_CALL(list, api)                       \
+  do                                                  \
+  {                                                   \
+    _CL_stat_add((list), &(list)->stats.calls[api], 1); \
+    if ((list)->ops == NULL)                          \
+      (list)->stats_api = (api);                      \
+  } while (0)
+#define CL_STAT_WALK(list, n) ((list)->stats.traversed[(list)->stats_api] += (n))
+#define CL_STAT_ALLOC(list, n) _CL_stat_add((list), &(list)->stats.allocs, (n))
+#define CL_STAT_FREE(list, n) _CL_stat_add((list), &(list)->stats.frees, (n))
+#define CL_STAT_PEAK(list) _CL_stat_peak(list)
+#else
+#define CL_STAT_CALL(list, api)
+#define CL_STAT_WALK(list, n)
+#define CL_STAT_ALLOC(list, n)
+#define CL_STAT_FREE(list, n)
+#define CL_STAT_PEAK(list)
+#endif
+
+// A slab is a header followed by an array of nodes. Nodes are carved
+// from the most recent slab in order; nodes that are released go onto
+// the pool's free list (threaded through their next pointers) and are
+// handed out again before any new node is carved.
+struct _cl_slab
+{
+  struct _cl_slab *next;
+  size_t capacity; // nodes in this slab
+  struct _cl_node nodes[];
+};
+
+struct _cl_node_pool
+{
+  struct _cl_slab *slabs;      // every slab owned by the pool
+  struct _cl_node *free_nodes; // released nodes, ready for reuse
+  int slab_nodes;              // nodes per slab, unless a run needs more
+  size_t carved;               // nodes carved so far from slabs->nodes
+  int refs;                    // the creator, plus one per list using the pool
+  CLNodePoolStats stats;
+};
+
+// An arena is a chain of blocks that memory is bump-allocated from.
+// Each block is twice the size of the one before it, so an arena
+// holding n nodes owns O(log n) blocks. Nothing allocated in an arena
+// is freed individually; nodes released by arena lists are kept on a
+// free list for reuse by any list in the same arena.
+struct _cl_arena_block
 {
-  CListElementType element;
-  struct _cl_node *next;
+  struct _cl_arena_block *next;
+  size_t size; // bytes available in data
+  size_t used; // bytes handed out from data
+  max_align_t data[];
 };
 
-struct _clist
+struct _cl_arena
 {
-  struct _cl_node *head;
-  int length;
+  struct _cl_arena_block *blocks; // most recent (and largest) first
+  size_t next_size;               // size of the next block to allocate
+  struct _cl_node *free_nodes;    // released nodes, ready for reuse
+  struct _cl_text_block *text;    // text blocks of the arena's lists
 };
 
+// A cursor sits on one element of a list (or just past the last one)
+// and remembers the node before it, so the element under the cursor
+// can be removed, or a new one inserted before it, without walking the
+// list. Lists with an alternative backend have no nodes here; their
+// cursors only track pos and go through the backend's positional
+// operations.
+struct _cl_cursor
+{
+  CList list;
+  struct _cl_node *prev; // node before the cursor, or NULL at the head
+  struct _cl_node *node; // node under the cursor, or NULL past the end
+  ptrdiff_t pos;         // position of the cursor
+};
+
+/*
+ * Bump-allocate memory from an arena, adding a new block if the
+ * current one cannot hold the request.
+ *
+ * Parameters:
+ *   arena  The arena
+ *   size   Number of bytes required
+ *
+ * Returns: Suitably aligned memory that lives until the arena is
+ *   reset or freed
+ */
+static void *
+_CL_arena_alloc(CLArena arena, size_t size)
+{
+  const size_t align = _Alignof(max_align_t);
+  size = (size + align - 1) & ~(align - 1);
+
+  struct _cl_arena_block *block = arena->blocks;
+  if (block == NULL || block->size - block->used < size)
+  {
+    while (arena->next_size < size)
+      arena->next_size *= 2;
+
+    block = (struct _cl_arena_block *)malloc(sizeof(struct _cl_arena_block) + arena->next_size);
+    assert(block);
+
+    block->size = arena->next_size;
+    block->used = 0;
+    block->next = arena->blocks;
+    arena->blocks = block;
+    arena->next_size *= 2;
+  }
+
+  void *mem = (char *)block->data + block->used;
+  block->used += size;
+
+  return mem;
+}
+
+/*
+ * Drop one reference to a pool, deallocating the pool and all of its
+ * slabs when the last reference goes away.
+ *
+ * Parameters:
+ *   pool   The pool
+ *
+ * Returns: None
+ */
+static void
+_CL_pool_release(CLNodePool pool)
+{
+  assert(pool->refs > 0);
+
+  if (--pool->refs > 0)
+    return;
+
+  struct _cl_slab *slab = pool->slabs;
+  while (slab != NULL)
+  {
+    struct _cl_slab *next_slab = slab->next;
+    free(slab);
+    slab = next_slab;
+  }
+
+  free(pool);
+}
+
+/*
+ * Add a new slab to a pool; later nodes are carved from it
+ *
+ * Parameters:
+ *   pool       The pool
+ *   capacity   Number of nodes in the new slab
+ *
+ * Returns: None
+ */
+static void
+_CL_pool_add_slab(CLNodePool pool, size_t capacity)
+{
+  struct _cl_slab *slab = (struct _cl_slab *)malloc(
+      sizeof(struct _cl_slab) + capacity * sizeof(struct _cl_node));
+  assert(slab);
+
+  slab->next = pool->slabs;
+  slab->capacity = capacity;
+  pool->slabs = slab;
+  pool->carved = 0;
+  pool->stats.slabs++;
+  pool->stats.capacity += capacity;
+}
+
+/*
+ * Record that n nodes have been handed out by a pool
+ */
+static inline void
+_CL_pool_count_allocs(CLNodePool pool, size_t n)
+{
+  pool->stats.allocs += n;
+  pool->stats.in_use += n;
+  if (pool->stats.in_use > pool->stats.peak_in_use)
+    pool->stats.peak_in_use = pool->stats.in_use;
+}
+
+/*
+ * Take a node from a pool, carving a new slab if there is no released
+ * node to reuse and the current slab is used up.
+ *
+ * Parameters:
+ *   pool   The pool
+ *
+ * Returns: The node; its contents are not initialized
+ */
+static struct _cl_node *
+_CL_pool_alloc(CLNodePool pool)
+{
+  struct _cl_node *new;
+
+  if (pool->free_nodes != NULL)
+  {
+    // reuse a released node
+    new = pool->free_nodes;
+    pool->free_nodes = new->next;
+    pool->stats.free_nodes--;
+  }
+  else
+  {
+    // carve a fresh node, starting a new slab if this one is used up
+    if (pool->slabs == NULL || pool->carved == pool->slabs->capacity)
+      _CL_pool_add_slab(pool, (size_t)pool->slab_nodes);
+    new = &pool->slabs->nodes[pool->carved++];
+  }
+
+  _CL_pool_count_allocs(pool, 1);
+
+  return new;
+}
+
+/*
+ * Take n nodes from a pool that are contiguous in memory. If the
+ * current slab does not have room for them, what is left of it goes
+ * onto the free list and the run is carved from a new slab, which is
+ * made large enough to hold the whole run.
+ *
+ * Parameters:
+ *   pool   The pool
+ *   n      Number of nodes required, at least 1
+ *
+ * Returns: The first of n consecutive nodes; their contents are not
+ *   initialized
+ */
+static struct _cl_node *
+_CL_pool_alloc_run(CLNodePool pool, size_t n)
+{
+  if (pool->slabs == NULL || pool->slabs->capacity - pool->carved < n)
+  {
+    if (pool->slabs != NULL)
+    {
+      while (pool->carved < pool->slabs->capacity)
+      {
+        struct _cl_node *spare = &pool->slabs->nodes[pool->carved++];
+        spare->next = pool->free_nodes;
+        pool->free_nodes = spare;
+        pool->stats.free_nodes++;
+      }
+    }
+    _CL_pool_add_slab(pool, (n > (size_t)pool->slab_nodes) ? n : (size_t)pool->slab_nodes);
+  }
+
+  struct _cl_node *run = &pool->slabs->nodes[pool->carved];
+  pool->carved += n;
+  _CL_pool_count_allocs(pool, n);
+
+  return run;
+}
+
+/*
+ * Store an element in a node, along with its prefix when
+ * CL_PREFIX_CACHE is defined
+ *
+ * Parameters:
+ *   node     The node
+ *   element  The element
+ *
+ * Returns: None
+ */
+static inline void
+_CL_set_element(struct _cl_node *node, CListElementType element)
+{
+  node->element = element;
+
+#ifdef CL_PREFIX_CACHE
+  // bytes after the terminating NUL count as zero, which sorts the
+  // same way strcmp treats a shorter string
+  uint64_t prefix = 0;
+  if (element != NULL)
+    for (int i = 0; i < 8 && element[i] != '\0'; i++)
+      prefix |= (uint64_t)(unsigned char)element[i] << (8 * (7 - i));
+  node->prefix = prefix;
+#endif
+}
+
+/*
+ * Compare the elements of two nodes following the rules for the
+ * strcmp function, using the cached prefixes when CL_PREFIX_CACHE is
+ * defined
+ *
+ * Parameters:
+ *   a, b   The nodes
+ *
+ * Returns: A negative value, zero or a positive value as the element
+ *   of a sorts before, equal to or after the element of b
+ */
+static inline int
+_CL_strcmp_nodes(const struct _cl_node *a, const struct _cl_node *b)
+{
+#ifdef CL_PREFIX_CACHE
+  if (a->prefix != b->prefix)
+    return (a->prefix < b->prefix) ? -1 : 1;
+#endif
+  return strcmp(a->element, b->element);
+}
+
+/*
+ * Create a new _cl_node for list and populate it with the supplied
+ * value. The node is taken from the list's pool or arena if it has
+ * one, and malloc'd otherwise. For an owning list the node is
+ * malloc'd with room for a copy of the element, which the node then
+ * holds instead of the caller's string.
+ *
+ * Parameters:
+ *   list     The list the node is for
+ *   element  The value for the node to be created
+ *
+ * Returns: The new node; its links are not initialized
+ */
+static struct _cl_node *
+_CL_new_node(CList list, CListElementType element)
+{
+  struct _cl_node *new;
+
+  if (list->pool != NULL)
+    new = _CL_pool_alloc(list->pool);
+
+  else if (list->arena != NULL)
+  {
+    CLArena arena = list->arena;
+    if (arena->free_nodes != NULL)
+    {
+      new = arena->free_nodes;
+      arena->free_nodes = new->next;
+    }
+    else
+      new = (struct _cl_node *)_CL_arena_alloc(arena, sizeof(struct _cl_node));
+  }
+
+  else if (list->owning && element != NULL)
+  {
+    size_t size = strlen(element) + 1;
+    struct _cl_owned_node *owned = (struct _cl_owned_node *)malloc(sizeof(struct _cl_owned_node) + size);
+    assert(owned);
+
+    memcpy(owned->data, element, size);
+    new = &owned->node;
+    element = owned->data;
+  }
+
+  else
+  {
+    new = (struct _cl_node *)malloc(sizeof(struct _cl_node));
+    assert(new);
+  }
+
+  _CL_set_element(new, element);
+  CL_STAT_ALLOC(list, 1);
+
+  return new;
+}
+
+/*
+ * Deallocate a node that belonged to list, returning it to the list's
+ * pool or arena if it has one. A node removed from an owning list
+ * holds the element just handed back to the caller, so it is kept as
+ * list->removed and the previously removed node is deallocated
+ * instead.
+ *
+ * Parameters:
+ *   list   The list the node belonged to
+ *   node   The node, which must already be unlinked
+ *
+ * Returns: None
+ */
+static void
+_CL_free_node(CList list, struct _cl_node *node)
+{
+  CL_STAT_FREE(list, 1);
+
+  if (list->pool != NULL)
+  {
+    CLNodePool pool = list->pool;
+    node->next = pool->free_nodes;
+    pool->free_nodes = node;
+    pool->stats.free_nodes++;
+    pool->stats.in_use--;
+    pool->stats.releases++;
+  }
+
+  else if (list->arena != NULL)
+  {
+    node->next = list->arena->free_nodes;
+    list->arena->free_nodes = node;
+  }
+
+  else if (list->owning)
+  {
+    free(list->removed);
+    list->removed = node;
+  }
+
+  else
+    free(node);
+}
+
+/*
+ * Determine whether nodes can be relinked from one list to another,
+ * which requires both lists to use the same backend and to allocate
+ * their nodes from the same place.
+ *
+ * Parameters:
+ *   list1, list2   The lists
+ *
+ * Returns: true if the lists are compatible, false otherwise
+ */
+static bool
+_CL_can_relink(CList list1, CList list2)
+{
+  return list1->ops == list2->ops && list1->pool == list2->pool &&
+         list1->arena == list2->arena && list1->owning == list2->owning;
+}
+
+/*
+ * Link a run of nodes, already chained together through their next
+ * (and prev) links, into the list directly after prev, keeping head,
+ * tail, prev links, length and the finger up to date.
+ *
+ * Parameters:
+ *   list   The list
+ *   prev   The node to link after, or NULL to link at the head
+ *   first  The first node of the run
+ *   last   The last node of the run
+ *   n      The number of nodes in the run
+ *   pos    The position first takes in the list
+ *
+ * Returns: None
+ */
+static void
+_CL_link_run_after(CList list, struct _cl_node *prev, struct _cl_node *first,
+                   struct _cl_node *last, ptrdiff_t n, ptrdiff_t pos)
+{
+  struct _cl_node *next = (prev == NULL) ? list->head : prev->next;
+
+  last->next = next;
+  if (prev == NULL)
+    list->head = first;
+  else
+    prev->next = first;
+
+  if (next == NULL)
+    list->tail = last;
+
+#ifdef CL_DOUBLY_LINKED
+  first->prev = prev;
+  if (next != NULL)
+    next->prev = last;
+#endif
+
+  // the finger's node moves up if it was at or after pos
+  if (list->finger != NULL && list->finger_pos >= pos)
+    list->finger_pos += n;
+
+  list->length += n;
+  CL_STAT_PEAK(list);
+}
+
+/*
+ * Link a single node into the list directly after prev; see
+ * _CL_link_run_after.
+ *
+ * Parameters:
+ *   list   The list
+ *   prev   The node to link after, or NULL to link at the head
+ *   node   The node to link in
+ *   pos    The position node takes in the list
+ *
+ * Returns: None
+ */
+static inline void
+_CL_link_after(CList list, struct _cl_node *prev, struct _cl_node *node, ptrdiff_t pos)
+{
+  _CL_link_run_after(list, prev, node, node, 1, pos);
+}
+
+/*
+ * Create a run of nodes holding the given elements, chained together
+ * in order (or in reverse order). For lists with a pool or an arena,
+ * the nodes are allocated together, contiguous in memory.
+ *
+ * Parameters:
+ *   list       The list the nodes are for
+ *   elements   The elements for the nodes
+ *   n          The number of elements, at least 1
+ *   reverse    If true, the run holds the elements in reverse order
+ *   last       Set to the last node of the run
+ *
+ * Returns: The first node of the run; the run is not yet linked into
+ *   the list
+ */
+static struct _cl_node *
+_CL_new_run(CList list, const CListElementType *elements, ptrdiff_t n, bool reverse,
+            struct _cl_node **last)
+{
+  struct _cl_node *block = NULL;
+  if (list->pool != NULL)
+    block = _CL_pool_alloc_run(list->pool, (size_t)n);
+  else if (list->arena != NULL)
+    block = (struct _cl_node *)_CL_arena_alloc(list->arena, (size_t)n * sizeof(struct _cl_node));
+  if (block != NULL)
+    CL_STAT_ALLOC(list, n);
+
+  struct _cl_node *first = NULL, *prev = NULL;
+  for (ptrdiff_t i = 0; i < n; i++)
+  {
+    CListElementType element = elements[reverse ? n - 1 - i : i];
+    struct _cl_node *node;
+    if (block != NULL)
+    {
+      node = &block[i];
+      _CL_set_element(node, element);
+    }
+    else
+      node = _CL_new_node(list, element);
+
+    if (prev == NULL)
+      first = node;
+    else
+      prev->next = node;
+#ifdef CL_DOUBLY_LINKED
+    node->prev = prev;
+#endif
+    prev = node;
+  }
+
+  *last = prev;
+  return first;
+}
+
+/*
+ * Unlink node from the list, keeping head, tail, prev links, length
+ * and the finger up to date. The node itself is not deallocated.
+ *
+ * Parameters:
+ *   list   The list
+ *   prev   The node before node, or NULL if node is the head
+ *   node   The node to unlink
+ *   pos    The position of node in the list
+ *
+ * Returns: None
+ */
+static void
+_CL_unlink(CList list, struct _cl_node *prev, struct _cl_node *node, ptrdiff_t pos)
+{
+  if (prev == NULL)
+    list->head = node->next;
+  else
+    prev->next = node->next;
+
+  if (node->next == NULL)
+    list->tail = prev;
+
+#ifdef CL_DOUBLY_LINKED
+  if (node->next != NULL)
+    node->next->prev = prev;
+#endif
+
+  // a finger on the unlinked node falls back to its predecessor, and
+  // one after it moves down one position
+  if (list->finger == node)
+  {
+    list->finger = prev;
+    list->finger_pos = pos - 1;
+  }
+  else if (list->finger != NULL && list->finger_pos > pos)
+    list->finger_pos--;
+
+  list->length--;
+}
+
 /*
- * Create (malloc) a new _cl_node and populate it with the supplied
- * values
+ * Find the node at a given position.
  *
  * Parameters:
- *   element, next  the values for the node to be created
+ *   list   The list
+ *   pos    Position of the node, in the range [0, length-1]
+ *
+ * The head and tail are returned without any traversal. Otherwise the
+ * walk starts from whichever of the head and the finger (the node
+ * found by the previous call) is closer, so sequential and
+ * near-sequential access is cheap. With CL_DOUBLY_LINKED the walk may
+ * also go backward, from the finger or from the tail. The node found
+ * becomes the new finger.
  *
- * Returns: The newly-malloc'd node, or NULL in case of error
+ * Returns: The node at position pos
  */
 static struct _cl_node *
-_CL_new_node(CListElementType element, struct _cl_node *next)
+_CL_node_at(CList list, ptrdiff_t pos)
 {
-  struct _cl_node *new = (struct _cl_node *)malloc(sizeof(struct _cl_node));
+  assert(pos >= 0 && pos < list->length);
 
-  assert(new);
+  if (pos == 0)
+    return list->head;
+  if (pos == list->length - 1)
+    return list->tail;
+
+  // by default walk forward from the head
+  struct _cl_node *this_node = list->head;
+  ptrdiff_t distance = pos;
+  bool from_finger = false;
+
+  if (list->finger != NULL && pos >= list->finger_pos && pos - list->finger_pos < distance)
+  {
+    this_node = list->finger;
+    distance = pos - list->finger_pos;
+    from_finger = true;
+  }
+
+#ifdef CL_DOUBLY_LINKED
+  // negative distances walk backward
+  if (list->finger != NULL && pos < list->finger_pos && list->finger_pos - pos < distance)
+  {
+    this_node = list->finger;
+    distance = pos - list->finger_pos;
+    from_finger = true;
+  }
+
+  if (list->length - 1 - pos < (distance < 0 ? -distance : distance))
+  {
+    this_node = list->tail;
+    distance = pos - (list->length - 1);
+    from_finger = false;
+  }
+#endif
+
+  CL_STAT_WALK(list, (distance < 0) ? -distance : distance);
+
+#ifdef CL_DOUBLY_LINKED
+  for (; distance < 0; distance++)
+    this_node = this_node->prev;
+#endif
+
+  for (; distance > 0; distance--)
+    this_node = this_node->next;
+
+  if (from_finger)
+    list->finger_hits++;
+  else
+    list->finger_misses++;
+
+  list->finger = this_node;
+  list->finger_pos = pos;
+
+  return this_node;
+}
+
+/*
+ * Return the length of a list, read atomically if the list has a
+ * concurrent backend and so may be changed by other threads at any
+ * time. For such lists the result is only a snapshot, and the backend
+ * checks positions against the list it actually finds.
+ */
+static inline ptrdiff_t
+_CL_current_length(CList list)
+{
+  if (list->ops != NULL && list->ops->concurrent)
+    return __atomic_load_n(&list->length, __ATOMIC_RELAXED);
+
+  return list->length;
+}
+
+// Documented in .h file
+CList CL_new()
+{
+  CList list = (CList)malloc(sizeof(struct _clist));
+  assert(list);
+
+  list->head = NULL;
+  list->tail = NULL;
+  list->length = 0;
+  list->pool = NULL;
+  list->arena = NULL;
+  list->finger = NULL;
+  list->finger_pos = 0;
+  list->finger_hits = 0;
+  list->finger_misses = 0;
+  list->owning = false;
+  list->removed = NULL;
+  list->mapping = NULL;
+  list->mapping_size = 0;
+  list->text = NULL;
+  list->ops = NULL;
+  list->impl = NULL;
+#ifdef CL_STATS
+  memset(&list->stats, 0, sizeof(list->stats));
+  list->stats_api = CL_API_PUSH;
+#endif
+
+  return list;
+}
+
+// Documented in .h file
+CList CL_new_owning()
+{
+  CList list = CL_new();
+  list->owning = true;
+
+  return list;
+}
+
+// Documented in .h file
+CLNodePool CL_pool_new(int slab_nodes)
+{
+  assert(slab_nodes >= 0);
+
+  CLNodePool pool = (CLNodePool)malloc(sizeof(struct _cl_node_pool));
+  assert(pool);
+
+  pool->slabs = NULL;
+  pool->free_nodes = NULL;
+  pool->slab_nodes = (slab_nodes > 0) ? slab_nodes : CL_POOL_DEFAULT_SLAB_NODES;
+  pool->carved = 0;
+  pool->refs = 1;
+  memset(&pool->stats, 0, sizeof(pool->stats));
+
+  return pool;
+}
+
+// Documented in .h file
+void CL_pool_free(CLNodePool pool)
+{
+  assert(pool);
+  _CL_pool_release(pool);
+}
+
+// Documented in .h file
+void CL_pool_stats(CLNodePool pool, CLNodePoolStats *stats)
+{
+  assert(pool);
+  assert(stats);
+  *stats = pool->stats;
+}
+
+// Documented in .h file
+CList CL_new_with_pool(CLNodePool pool)
+{
+  assert(pool);
+
+  CList list = CL_new();
+  list->pool = pool;
+  pool->refs++;
+
+  return list;
+}
+
+/*
+ * Free a chain of text blocks
+ *
+ * Parameters:
+ *   text   The first block of the chain, or NULL; set to NULL
+ *
+ * Returns: None
+ */
+static void
+_CL_free_text(struct _cl_text_block **text)
+{
+  while (*text != NULL)
+  {
+    struct _cl_text_block *next_block = (*text)->next;
+    free(*text);
+    *text = next_block;
+  }
+}
+
+// Documented in clist_internal.h
+void _CL_keep_text(CList list, struct _cl_text_block *block)
+{
+  // a list in an arena may never be freed on its own, so its blocks go
+  // with the arena
+  struct _cl_text_block **text = (list->arena != NULL) ? &list->arena->text : &list->text;
+
+  block->next = *text;
+  *text = block;
+}
+
+// Documented in .h file
+CLArena CL_arena_new(size_t block_size)
+{
+  CLArena arena = (CLArena)malloc(sizeof(struct _cl_arena));
+  assert(arena);
+
+  arena->blocks = NULL;
+  arena->next_size = (block_size > 0) ? block_size : CL_ARENA_DEFAULT_BLOCK_SIZE;
+  arena->free_nodes = NULL;
+  arena->text = NULL;
+
+  return arena;
+}
+
+// Documented in .h file
+void CL_arena_reset(CLArena arena)
+{
+  assert(arena);
+
+  if (arena->blocks == NULL)
+    return;
+
+  // keep the most recent block, which is the largest, for reuse and
+  // release all the others
+  struct _cl_arena_block *block = arena->blocks->next;
+  while (block != NULL)
+  {
+    struct _cl_arena_block *next_block = block->next;
+    free(block);
+    block = next_block;
+  }
+
+  arena->blocks->next = NULL;
+  arena->blocks->used = 0;
+  arena->free_nodes = NULL;
+  _CL_free_text(&arena->text);
+}
+
+// Documented in .h file
+void CL_arena_free(CLArena arena)
+{
+  assert(arena);
+
+  struct _cl_arena_block *block = arena->blocks;
+  while (block != NULL)
+  {
+    struct _cl_arena_block *next_block = block->next;
+    free(block);
+    block = next_block;
+  }
+
+  _CL_free_text(&arena->text);
+  free(arena);
+}
+
+// Documented in .h file
+CList CL_new_in_arena(CLArena arena)
+{
+  assert(arena);
+
+  CList list = (CList)_CL_arena_alloc(arena, sizeof(struct _clist));
+
+  list->head = NULL;
+  list->tail = NULL;
+  list->length = 0;
+  list->pool = NULL;
+  list->arena = arena;
+  list->finger = NULL;
+  list->finger_pos = 0;
+  list->finger_hits = 0;
+  list->finger_misses = 0;
+  list->owning = false;
+  list->removed = NULL;
+  list->mapping = NULL;
+  list->mapping_size = 0;
+  list->text = NULL;
+  list->ops = NULL;
+  list->impl = NULL;
+#ifdef CL_STATS
+  memset(&list->stats, 0, sizeof(list->stats));
+  list->stats_api = CL_API_PUSH;
+#endif
+
+  return list;
+}
+
+// Documented in .h file
+void CL_free(CList list)
+{
+  assert(list);
+
+  // the elements of a mapped snapshot go with it
+  if (list->mapping != NULL)
+    munmap(list->mapping, list->mapping_size);
+
+  // as do the blocks that CL_append_lines cut elements out of
+  _CL_free_text(&list->text);
+
+  if (list->ops != NULL)
+  {
+    list->ops->free(list);
+    free(list);
+    return;
+  }
+
+  // an arena list and its nodes are released with the arena; just make
+  // its nodes available to other lists in the arena
+  if (list->arena != NULL)
+  {
+    if (list->head != NULL)
+    {
+      list->tail->next = list->arena->free_nodes;
+      list->arena->free_nodes = list->head;
+    }
+    return;
+  }
+
+  // a pooled list hands its whole chain back to the pool's free list
+  // in one step, then lets go of the pool
+  if (list->pool != NULL)
+  {
+    CLNodePool pool = list->pool;
+    if (list->head != NULL)
+    {
+      list->tail->next = pool->free_nodes;
+      pool->free_nodes = list->head;
+      pool->stats.free_nodes += list->length;
+      pool->stats.in_use -= list->length;
+      pool->stats.releases += list->length;
+    }
+    _CL_pool_release(pool);
+    free(list);
+    return;
+  }
+
+  // deallocate all the nodes in the list
+  struct _cl_node *this_node = list->head;
+
+  // traverse the list, deallocating each node
+  while (this_node != NULL)
+  {
+    struct _cl_node *next_node = this_node->next;
+
+    // deallocate the current node
+    free(this_node);
+
+    // move on to the next node
+    this_node = next_node;
+  }
+
+  // an owning list also holds on to its last removed node
+  free(list->removed);
+
+  // deallocate the list structure itself
+  free(list);
+}
+
+// Documented in .h file
+int CL_length(CList list)
+{
+  size_t length = CL_length64(list);
+
+  // longer lists need CL_length64
+  assert(length <= INT_MAX);
+  return (length <= INT_MAX) ? (int)length : INT_MAX;
+}
+
+// Documented in .h file
+size_t CL_length64(CList list)
+{
+  assert(list);
+
+  // other threads may be pushing and popping; the length is only
+  // checked when they are not
+  if (list->ops != NULL && list->ops->concurrent)
+    return _CL_current_length(list);
+
+  // a linked list has a head exactly when it has elements
+  assert(list->ops != NULL || (list->head == NULL) == (list->length == 0));
+
+#if CL_CHECK_LEVEL >= 2
+  // as a defensive programming method to catch bugs in our code, the
+  // full checking tier walks the whole list on every call, making sure
+  // that the stored length and the rest of its structure are right
+  assert(CL_validate(list));
+#endif
+
+  return (size_t)list->length;
+}
+
+// Documented in .h file
+bool CL_validate(CList list)
+{
+  assert(list);
+
+  if (list->ops != NULL)
+    return list->ops->check == NULL || list->ops->check(list);
+
+  if (list->length < 0 || (list->head == NULL) != (list->length == 0) ||
+      (list->head == NULL) != (list->tail == NULL))
+    return false;
+
+  // the walk gives up once it has passed more nodes than the list
+  // should have, so links that loop back on themselves cannot keep it
+  // going for ever; either they loop or the length is wrong
+  ptrdiff_t len = 0;
+  struct _cl_node *last = NULL;
+  bool finger_found = false;
+  for (struct _cl_node *node = list->head; node != NULL; node = node->next)
+  {
+    if (len == list->length)
+      return false;
+#ifdef CL_DOUBLY_LINKED
+    if (node->prev != last)
+      return false;
+#endif
+#ifdef CL_PREFIX_CACHE
+    struct _cl_node expected;
+    _CL_set_element(&expected, node->element);
+    if (node->prefix != expected.prefix)
+      return false;
+#endif
+    if (node == list->finger)
+      finger_found = (len == list->finger_pos);
+    last = node;
+    len++;
+  }
+
+  return len == list->length && last == list->tail && (list->finger == NULL || finger_found);
+}
+
+/*
+ * Position a cursor on the first element of list
+ *
+ * Parameters:
+ *   cursor   The cursor
+ *   list     The list
+ *
+ * Returns: None
+ */
+static void
+_CL_cursor_init(struct _cl_cursor *cursor, CList list)
+{
+  cursor->list = list;
+  cursor->prev = NULL;
+  cursor->node = (list->ops == NULL) ? list->head : NULL;
+  cursor->pos = 0;
+}
+
+/*
+ * Move a cursor on a linked list to the next element; the cursor must
+ * not be past the end
+ */
+static inline void
+_CL_cursor_advance(struct _cl_cursor *cursor)
+{
+  cursor->prev = cursor->node;
+  cursor->node = cursor->node->next;
+  cursor->pos++;
+}
+
+/*
+ * CL_foreach64 callback used by CL_print for lists with an alternative
+ * backend
+ */
+static void
+_CL_print_element(size_t pos, CListElementType element, void *cb_data)
+{
+  printf("  [%zu]: %s\n", pos, element);
+}
+
+// Documented in .h file
+void CL_print(CList list)
+{
+  assert(list);
+
+  if (list->ops != NULL)
+  {
+    list->ops->foreach(list, _CL_print_element, NULL);
+    return;
+  }
+
+  size_t num = 0;
+  for (struct _cl_node *node = list->head; node != NULL; node = node->next)
+    printf("  [%zu]: %s\n", num++, node->element);
+}
+
+// Documented in .h file
+void CL_push(CList list, CListElementType element)
+{
+  assert(list);
+  CL_STAT_CALL(list, CL_API_PUSH);
+
+  if (list->ops != NULL)
+  {
+    list->ops->push(list, element);
+    CL_STAT_PEAK(list);
+    return;
+  }
+
+  _CL_link_after(list, NULL, _CL_new_node(list, element), 0);
+}
+
+// Documented in .h file
+CListElementType CL_pop(CList list)
+{
+  assert(list);
+  CL_STAT_CALL(list, CL_API_POP);
+
+  // a concurrent list may be emptied by another thread at any time, so
+  // its pop checks for itself
+  if (list->ops != NULL && list->ops->concurrent)
+    return list->ops->pop(list);
+
+  if (list->length == 0)
+    return INVALID_RETURN;
+
+  if (list->ops != NULL)
+    return list->ops->pop(list);
+
+  struct _cl_node *popped_node = list->head;
+
+  CListElementType ret = popped_node->element;
+
+  // unlink previous head node, then free it
+  _CL_unlink(list, NULL, popped_node, 0);
+  _CL_free_node(list, popped_node);
+  // we cannot refer to popped node any longer
+
+  return ret;
+}
+
+// Documented in .h file
+void CL_append(CList list, CListElementType element)
+{
+  assert(list);
+  CL_STAT_CALL(list, CL_API_APPEND);
+
+  if (list->ops != NULL)
+  {
+    list->ops->append(list, element);
+    CL_STAT_PEAK(list);
+    return;
+  }
+
+  // the tail pointer lets us link the new node in without a traversal;
+  // on an empty list the tail is NULL and the new node becomes the head
+  _CL_link_after(list, list->tail, _CL_new_node(list, element), list->length);
+}
+
+// Documented in .h file
+void CL_append_array(CList list, const CListElementType *elements, int n)
+{
+  assert(list);
+  CL_insert_array(list, elements, n, -1);
+}
+
+// Documented in .h file
+void CL_push_array(CList list, const CListElementType *elements, int n)
+{
+  assert(list);
+  assert(n >= 0);
+  CL_STAT_CALL(list, CL_API_PUSH_ARRAY);
+
+  if (n == 0)
+    return;
+  assert(elements);
+
+  if (list->ops != NULL)
+  {
+    for (int i = 0; i < n; i++)
+      list->ops->push(list, elements[i]);
+    CL_STAT_PEAK(list);
+    return;
+  }
+
+  // pushing elements[0] first leaves elements[n-1] at the head, so the
+  // run holds the elements in reverse
+  struct _cl_node *last;
+  struct _cl_node *first = _CL_new_run(list, elements, n, true, &last);
+  _CL_link_run_after(list, NULL, first, last, n, 0);
+}
+
+// Documented in .h file
+bool CL_insert_array(CList list, const CListElementType *elements, int n, int pos)
+{
+  assert(list);
+  assert(n >= 0);
+  CL_STAT_CALL(list, CL_API_INSERT_ARRAY);
+
+  // convert negative pos to positive by counting from the end of the list
+  ptrdiff_t at = (pos < 0) ? list->length + pos + 1 : pos;
+
+  // bounds check - if pos is negative or out of bounds, it's an error
+  if (at < 0 || at > list->length)
+    return false;
+
+  if (n == 0)
+    return true;
+  assert(elements);
+
+  if (list->ops != NULL)
+  {
+    for (int i = 0; i < n; i++)
+      list->ops->insert(list, elements[i], at + i);
+    CL_STAT_PEAK(list);
+    return true;
+  }
+
+  // build the whole run, then link it in after the node before it with
+  // a single walk
+  struct _cl_node *prev_node = (at == 0) ? NULL : _CL_node_at(list, at - 1);
+  struct _cl_node *last;
+  struct _cl_node *first = _CL_new_run(list, elements, n, false, &last);
+  _CL_link_run_after(list, prev_node, first, last, n, at);
+
+  return true;
+}
+
+// Destination for _CL_to_array_element
+struct _cl_array_out
+{
+  CListElementType *out;
+  size_t n;
+  size_t filled; // slots of out written so far
+};
+
+/*
+ * CL_foreach64 callback used by CL_to_array for lists with an
+ * alternative backend
+ */
+static void
+_CL_to_array_element(size_t pos, CListElementType element, void *cb_data)
+{
+  struct _cl_array_out *dest = (struct _cl_array_out *)cb_data;
+
+  if (pos < dest->n)
+  {
+    dest->out[pos] = element;
+    dest->filled = pos + 1;
+  }
+}
+
+// Copy up to n elements of list, from the head, into out; returns the number copied
+static size_t
+_CL_to_array(CList list, CListElementType *out, size_t n)
+{
+  size_t length = (size_t)_CL_current_length(list);
+  size_t count = (n < length) ? n : length;
+  if (count == 0)
+    return 0;
+  assert(out);
+
+  if (list->ops != NULL)
+  {
+    // a locked list may shrink under us, so count what the walk
+    // actually delivered rather than trusting the length read above
+    struct _cl_array_out dest = {out, count, 0};
+    list->ops->foreach(list, _CL_to_array_element, &dest);
+    return dest.filled;
+  }
+
+  struct _cl_node *node = list->head;
+  for (size_t i = 0; i < count; i++, node = node->next)
+    out[i] = node->element;
+
+  return count;
+}
+
+// Documented in .h file
+int CL_to_array(CList list, CListElementType *out, int n)
+{
+  assert(list);
+  assert(n >= 0);
+
+  return (int)_CL_to_array(list, out, (size_t)n);
+}
+
+// Documented in .h file
+CListElementType CL_nth(CList list, int pos)
+{
+  return CL_nth64(list, pos);
+}
+
+// Documented in .h file
+CListElementType CL_nth64(CList list, ptrdiff_t pos)
+{
+  assert(list);
+  CL_STAT_CALL(list, CL_API_NTH);
+  ptrdiff_t length = _CL_current_length(list);
+
+  // bounds check - if pos is negative or out of bounds, it's an error
+  if (pos < -length || pos >= length)
+    return INVALID_RETURN;
+
+  // convert negative pos to positive by counting from the end of the list
+  if (pos < 0)
+    pos = length + pos;
+
+  if (list->ops != NULL)
+    return list->ops->nth(list, pos);
+
+  return _CL_node_at(list, pos)->element;
+}
+
+// Documented in .h file
+bool CL_insert(CList list, CListElementType element, int pos)
+{
+  return CL_insert64(list, element, pos);
+}
+
+// Documented in .h file
+bool CL_insert64(CList list, CListElementType element, ptrdiff_t pos)
+{
+  assert(list);
+  CL_STAT_CALL(list, CL_API_INSERT);
+  ptrdiff_t length = _CL_current_length(list);
+
+  // convert negative pos to positive by counting from the end of the list
+  if (pos < 0)
+    pos = length + pos + 1;
+
+  // bounds check - if pos is negative or out of bounds, it's an error
+  if (pos < 0 || pos > length)
+    return false;
+
+  if (list->ops != NULL)
+  {
+    bool inserted = list->ops->insert(list, element, pos);
+    CL_STAT_PEAK(list);
+    return inserted;
+  }
+
+  // inserting at position 0 links at the head; otherwise link in after
+  // the node at position pos-1, which is the tail when appending
+  struct _cl_node *prev_node = (pos == 0) ? NULL : _CL_node_at(list, pos - 1);
+  _CL_link_after(list, prev_node, _CL_new_node(list, element), pos);
+
+  return true;
+}
+
+// Documented in .h file
+CListElementType CL_remove(CList list, int pos)
+{
+  return CL_remove64(list, pos);
+}
+
+// Documented in .h file
+CListElementType CL_remove64(CList list, ptrdiff_t pos)
+{
+  assert(list);
+  CL_STAT_CALL(list, CL_API_REMOVE);
+  ptrdiff_t length = _CL_current_length(list);
+
+  // If pos is negative, count from the end of the list
+  if (pos < 0)
+    pos = length + pos;
+
+  // If pos is still negative or out of bounds, it's an error
+  if (pos < 0 || pos >= length)
+    return INVALID_RETURN;
+
+  if (list->ops != NULL)
+    return list->ops->remove(list, pos);
+
+  // If pos is 0, just pop the head of the list
+  if (pos == 0)
+    return CL_pop(list);
+
+#ifdef CL_DOUBLY_LINKED
+  // find the node itself; its predecessor is one link away
+  struct _cl_node *rm_node = _CL_node_at(list, pos);
+  struct _cl_node *prev_node = rm_node->prev;
+#else
+  // find the node at position pos-1, then the one we are removing
+  struct _cl_node *prev_node = _CL_node_at(list, pos - 1);
+  struct _cl_node *rm_node = prev_node->next;
+#endif
+
+  // Save the element to return, then unlink and deallocate the node
+  CListElementType rm_element = rm_node->element;
+  _CL_unlink(list, prev_node, rm_node, pos);
+  _CL_free_node(list, rm_node);
+
+  return rm_element;
+}
+
+// Documented in .h file
+void CL_finger_stats(CList list, size_t *hits, size_t *misses)
+{
+  assert(list);
+  assert(hits);
+  assert(misses);
+
+  *hits = list->finger_hits;
+  *misses = list->finger_misses;
+}
+
+// Documented in .h file
+CList CL_copy(CList list)
+{
+  assert(list);
+  CL_STAT_CALL(list, CL_API_COPY);
+
+  if (list->ops != NULL)
+    return list->ops->copy(list);
+
+  // create a new list, drawing its nodes from the same place
+  CList list_copy;
+  if (list->pool != NULL)
+    list_copy = CL_new_with_pool(list->pool);
+  else if (list->arena != NULL)
+    list_copy = CL_new_in_arena(list->arena);
+  else if (list->owning)
+    list_copy = CL_new_owning();
+  else
+    list_copy = CL_new();
+
+  // traverse the list, appending each element to the new list
+  for (struct _cl_node *node = list->head; node != NULL; node = node->next)
+    CL_append(list_copy, node->element);
+
+  // return the newly-created copy
+  return list_copy;
+}
+
+// Documented in .h file
+int CL_insert_sorted(CList list, CListElementType element)
+{
+  size_t position = CL_insert_sorted64(list, element);
+
+  // positions in longer lists need CL_insert_sorted64
+  assert(position <= INT_MAX);
+  return (int)position;
+}
+
+// Documented in .h file
+size_t CL_insert_sorted64(CList list, CListElementType element)
+{
+  assert(list);
+  CL_STAT_CALL(list, CL_API_INSERT_SORTED);
+
+  if (list->ops != NULL)
+  {
+    ptrdiff_t position = list->ops->insert_sorted(list, element);
+    CL_STAT_PEAK(list);
+    return (size_t)position;
+  }
+
+  // the new node is compared against the nodes already in the list
+  struct _cl_node *new_node = _CL_new_node(list, element);
+
+  // if the element sorts after the tail (or the list is empty), it
+  // belongs at the end, which the tail pointer reaches directly
+  if (list->tail == NULL || _CL_strcmp_nodes(list->tail, new_node) < 0)
+  {
+    _CL_link_after(list, list->tail, new_node, list->length);
+    return (size_t)list->length - 1;
+  }
+
+  // otherwise, traverse the list until we find the first element that is
+  // greater than or equal to the element we are inserting; the tail
+  // guarantees such an element exists
+  struct _cl_node *prev_node = NULL;
+  struct _cl_node *this_node = list->head;
+  size_t position = 0;
+  while (_CL_strcmp_nodes(this_node, new_node) < 0)
+  {
+    prev_node = this_node;
+    this_node = this_node->next;
+    position++;
+  }
+  CL_STAT_WALK(list, position);
+
+  // link the new element in just before this_node
+  _CL_link_after(list, prev_node, new_node, (ptrdiff_t)position);
+
+  // return the position of the newly-inserted element
+  return position;
+}
+
+/*
+ * Merge two sorted, NULL-terminated chains of nodes into one. The
+ * merge is stable: when elements compare equal, those from a come
+ * first.
+ *
+ * Parameters:
+ *   a, b   The chains; every node of a came before every node of b
+ *   cmp    The comparison function, or NULL to compare nodes with
+ *          _CL_strcmp_nodes
+ *
+ * Returns: The head of the merged chain
+ */
+static struct _cl_node *
+_CL_merge_chains(struct _cl_node *a, struct _cl_node *b, CL_compare_fn cmp)
+{
+  struct _cl_node head;
+  struct _cl_node *last = &head;
+
+  while (a != NULL && b != NULL)
+  {
+    int order = (cmp == NULL) ? _CL_strcmp_nodes(b, a) : cmp(b->element, a->element);
+    if (order < 0)
+    {
+      last->next = b;
+      b = b->next;
+    }
+    else
+    {
+      last->next = a;
+      a = a->next;
+    }
+    last = last->next;
+  }
+  last->next = (a != NULL) ? a : b;
+
+  return head.next;
+}
+
+/*
+ * Stable merge sort of an array, used for lists with an alternative
+ * backend
+ *
+ * Parameters:
+ *   elements   The array to sort
+ *   scratch    Scratch space for n elements
+ *   n          The number of elements
+ *   cmp        The comparison function
+ *
+ * Returns: None
+ */
+static void
+_CL_sort_array(CListElementType *elements, CListElementType *scratch, size_t n, CL_compare_fn cmp)
+{
+  // each pass merges runs of width elements from src into dst
+  CListElementType *src = elements, *dst = scratch;
+
+  for (size_t width = 1; width < n; width *= 2)
+  {
+    for (size_t lo = 0; lo < n; lo += 2 * width)
+    {
+      size_t mid = (width < n - lo) ? lo + width : n;
+      size_t hi = (2 * width < n - lo) ? lo + 2 * width : n;
+      size_t i = lo, j = mid, k = lo;
+
+      while (i < mid && j < hi)
+        dst[k++] = (cmp(src[j], src[i]) < 0) ? src[j++] : src[i++];
+      while (i < mid)
+        dst[k++] = src[i++];
+      while (j < hi)
+        dst[k++] = src[j++];
+    }
+
+    CListElementType *tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+  if (src != elements)
+    memcpy(elements, src, (size_t)n * sizeof(CListElementType));
+}
+
+/*
+ * Stable merge sort of a NULL-terminated chain of nodes, by relinking
+ * them
+ *
+ * Parameters:
+ *   chain  The first node of the chain
+ *   cmp    The comparison function, or NULL to compare nodes with
+ *          _CL_strcmp_nodes
+ *
+ * Returns: The first node of the sorted chain
+ */
+static struct _cl_node *
+_CL_sort_chain(struct _cl_node *chain, CL_compare_fn cmp)
+{
+  // bottom-up merge sort: bins[i] is either empty or a sorted chain of
+  // 2^i nodes, holding earlier elements than any lower bin. Each node
+  // is merged in like a carry propagating through a binary counter.
+  struct _cl_node *bins[CL_SORT_BINS] = {NULL};
+  int max_bin = 0;
+
+  struct _cl_node *node = chain;
+  while (node != NULL)
+  {
+    struct _cl_node *carry = node;
+    node = node->next;
+    carry->next = NULL;
+
+    int i;
+    for (i = 0; bins[i] != NULL; i++)
+    {
+      carry = _CL_merge_chains(bins[i], carry, cmp);
+      bins[i] = NULL;
+    }
+    bins[i] = carry;
+    if (i > max_bin)
+      max_bin = i;
+  }
+
+  // merge the bins, lowest (latest elements) first
+  struct _cl_node *sorted = NULL;
+  for (int i = 0; i <= max_bin; i++)
+    if (bins[i] != NULL)
+      sorted = _CL_merge_chains(bins[i], sorted, cmp);
+
+  return sorted;
+}
+
+/*
+ * Make a linked list out of the sorted chain of its nodes: restore the
+ * tail and the prev links, and forget positions
+ *
+ * Parameters:
+ *   list     The list
+ *   sorted   The first node of the chain
+ *
+ * Returns: None
+ */
+static void
+_CL_finish_sort(CList list, struct _cl_node *sorted)
+{
+  list->head = sorted;
+  struct _cl_node *prev = NULL;
+  for (struct _cl_node *node = sorted; node != NULL; node = node->next)
+  {
+#ifdef CL_DOUBLY_LINKED
+    node->prev = prev;
+#endif
+    prev = node;
+  }
+  list->tail = prev;
+
+  // positions have all changed
+  list->finger = NULL;
+}
+
+// Documented in .h file
+void CL_sort(CList list, CL_compare_fn cmp)
+{
+  assert(list);
+  CL_STAT_CALL(list, CL_API_SORT);
+
+  // the default order is compared node by node, so that the cached
+  // prefixes can be used
+  if (cmp == strcmp)
+    cmp = NULL;
+
+  if (list->length < 2)
+    return;
+
+  if (list->ops != NULL)
+  {
+    // sort a copy of the elements, then rebuild the list from it
+    size_t n = (size_t)list->length;
+    CListElementType *elements = (CListElementType *)malloc(2 * n * sizeof(CListElementType));
+    assert(elements);
+
+    _CL_to_array(list, elements, n);
+    _CL_sort_array(elements, elements + n, n, (cmp != NULL) ? cmp : strcmp);
+    while (list->length > 0)
+      list->ops->pop(list);
+    for (size_t i = 0; i < n; i++)
+      list->ops->append(list, elements[i]);
+
+    free(elements);
+    return;
+  }
+
+  _CL_finish_sort(list, _CL_sort_chain(list->head, cmp));
+}
+
+// A job for _CL_sort_task. With width 0, each task sorts one run of
+// nodes; otherwise task k merges runs[2*width*k] with the run width
+// places after it, leaving the result in runs[2*width*k].
+struct _cl_sort_job
+{
+  struct _cl_node **runs;
+  int width;
+  CL_compare_fn cmp;
+};
+
+/*
+ * Task of CL_sort_parallel: sort a run, or merge two neighbouring runs
+ */
+static void
+_CL_sort_task(void *data, int task)
+{
+  struct _cl_sort_job *job = (struct _cl_sort_job *)data;
+
+  if (job->width == 0)
+  {
+    job->runs[task] = _CL_sort_chain(job->runs[task], job->cmp);
+    return;
+  }
+
+  int i = 2 * job->width * task;
+  job->runs[i] = _CL_merge_chains(job->runs[i], job->runs[i + job->width], job->cmp);
+}
+
+// Documented in .h file
+void CL_sort_parallel(CList list, CL_compare_fn cmp, int nthreads)
+{
+  assert(list);
+
+  // one run per thread, unless that would make the runs too short to be
+  // worth handing to another thread
+  int num_runs = _CL_workers_threads(nthreads);
+  if (num_runs > list->length / CL_SORT_MIN_RUN)
+    num_runs = (int)(list->length / CL_SORT_MIN_RUN);
+
+  if (list->ops != NULL || num_runs < 2)
+  {
+    CL_sort(list, cmp);
+    return;
+  }
+  CL_STAT_CALL(list, CL_API_SORT);
+
+  if (cmp == strcmp)
+    cmp = NULL;
+
+  struct _cl_sort_job job = {NULL, 0, cmp};
+  job.runs = (struct _cl_node **)malloc((size_t)num_runs * sizeof(struct _cl_node *));
+  assert(job.runs);
+
+  // cut the chain into runs of about the same length
+  struct _cl_node *node = list->head;
+  ptrdiff_t start = 0;
+  for (int r = 0; r < num_runs; r++)
+  {
+    ptrdiff_t end = list->length * (r + 1) / num_runs;
+
+    job.runs[r] = node;
+    for (ptrdiff_t pos = start + 1; pos < end; pos++)
+      node = node->next;
+
+    struct _cl_node *next = node->next;
+    node->next = NULL;
+    node = next;
+    start = end;
+  }
 
-  new->element = element;
-  new->next = next;
+  // sort the runs, then merge neighbouring runs in rounds, the merges
+  // of each round in parallel. Only runs next to each other are merged,
+  // earlier run first, so the sort is as stable as CL_sort.
+  _CL_workers_run(num_runs, num_runs, _CL_sort_task, &job);
+  for (job.width = 1; job.width < num_runs; job.width *= 2)
+  {
+    int num_merges = (num_runs - job.width + 2 * job.width - 1) / (2 * job.width);
+    _CL_workers_run(num_merges, num_merges, _CL_sort_task, &job);
+  }
 
-  return new;
+  _CL_finish_sort(list, job.runs[0]);
+  free(job.runs);
 }
 
 // Documented in .h file
-CList CL_new()
+void CL_join(CList list1, CList list2)
 {
-  CList list = (CList)malloc(sizeof(struct _clist));
-  assert(list);
-
-  list->head = NULL;
-  list->length = 0;
+  assert(list1);
+  assert(list2);
+  CL_STAT_CALL(list1, CL_API_JOIN);
 
-  return list;
-}
+  // nothing to move if list2 is empty
+  if (list2->length == 0)
+    return;
 
-// Documented in .h file
-void CL_free(CList list)
-{
-  assert(list);
+  // an empty list that allocates with malloc becomes owning when an
+  // owning list is joined to it. Any other list would be left holding
+  // strings freed along with list2's nodes, so the join is refused.
+  if (list2->owning && !list1->owning)
+  {
+    if (list1->length != 0 || list1->ops != NULL || list1->pool != NULL ||
+        list1->arena != NULL)
+      return;
+    list1->owning = true;
+  }
 
-  // deallocate all the nodes in the list
-  struct _cl_node *this_node = list->head;
+  // likewise an empty list that allocates with malloc can take on the
+  // pool of the list joined to it, unless it is owning, since pooled
+  // nodes have no room for a copy of the element
+  if (list1->length == 0 && list1->ops == NULL && list1->pool == NULL &&
+      list1->arena == NULL && !list1->owning && list2->ops == NULL && list2->pool != NULL)
+  {
+    list1->pool = list2->pool;
+    list1->pool->refs++;
+  }
 
-  // traverse the list, deallocating each node
-  while (this_node != NULL)
+  // nodes can only be relinked between lists that share a backend and
+  // allocate them from the same place; otherwise move the elements one
+  // at a time
+  if (!_CL_can_relink(list1, list2))
   {
-    struct _cl_node *next_node = this_node->next;
+    while (list2->length > 0)
+      CL_append(list1, CL_pop(list2));
+    return;
+  }
 
-    // deallocate the current node
-    free(this_node);
+  if (list1->ops != NULL)
+  {
+    list1->ops->join(list1, list2);
+    CL_STAT_PEAK(list1);
+    return;
+  }
 
-    // move on to the next node
-    this_node = next_node;
+  // if list1 is empty, just point it at list2; otherwise point the
+  // tail of list1 at the head of list2
+  if (list1->head == NULL)
+    list1->head = list2->head;
+  else
+  {
+    list1->tail->next = list2->head;
+#ifdef CL_DOUBLY_LINKED
+    list2->head->prev = list1->tail;
+#endif
   }
 
-  // deallocate the list structure itself
-  free(list);
+  list1->tail = list2->tail;
+  list1->length = list1->length + list2->length;
+  CL_STAT_PEAK(list1);
+
+  // empty list2
+  list2->head = NULL;
+  list2->tail = NULL;
+  list2->finger = NULL;
+  list2->length = 0;
 }
 
 // Documented in .h file
-int CL_length(CList list)
+void CL_reverse(CList list)
 {
   assert(list);
-#ifdef DEBUG
-  // In production code, we simply return the stored value for
-  // length. However, as a defensive programming method to prevent
-  // bugs in our code, in DEBUG mode we traverse the list and ensure the
-  // number of elements on the list is equal to the stored length.
+  CL_STAT_CALL(list, CL_API_REVERSE);
 
-  int len = 0;
-  for (struct _cl_node *node = list->head; node != NULL; node = node->next)
-    len++;
+  if (list->ops != NULL)
+  {
+    list->ops->reverse(list);
+    return;
+  }
 
-  assert(len == list->length);
-#endif // DEBUG
+  // reverse if list is not empty
+  if (list->head != NULL)
+  {
+    // keep track of previous, current and next nodes
+    struct _cl_node *prev_node = NULL;
+    struct _cl_node *next_node = NULL;
+    struct _cl_node *this_node = list->head;
 
-  return list->length;
+    // traverse the list, reversing the direction of each next pointers of each node
+    while (this_node != NULL)
+    {
+      next_node = this_node->next;
+      this_node->next = prev_node;
+#ifdef CL_DOUBLY_LINKED
+      this_node->prev = next_node;
+#endif
+      prev_node = this_node;
+      this_node = next_node;
+    }
+
+    // the old head is now the tail; update head of list to point to the last node
+    list->tail = list->head;
+    list->head = prev_node;
+
+    // the finger's node stays the same, at the mirrored position
+    list->finger_pos = list->length - 1 - list->finger_pos;
+  }
 }
 
-// Documented in .h file
-void CL_print(CList list)
+// A CL_foreach callback, and its data, wrapped for a backend's foreach
+struct _cl_foreach_int
 {
-  assert(list);
-  int num = 0;
-  for (struct _cl_node *node = list->head; node != NULL; node = node->next)
-    printf("  [%d]: %s\n", num++, node->element);
-}
+  CL_foreach_callback callback;
+  void *cb_data;
+};
 
-// Documented in .h file
-void CL_push(CList list, CListElementType element)
+/*
+ * CL_foreach64 callback used by CL_foreach for lists with an
+ * alternative backend: pass the call on with an int position
+ */
+static void
+_CL_foreach_int(size_t pos, CListElementType element, void *cb_data)
 {
-  assert(list);
-  list->head = _CL_new_node(element, list->head);
-  list->length++;
+  struct _cl_foreach_int *wrapped = (struct _cl_foreach_int *)cb_data;
+  wrapped->callback((int)pos, element, wrapped->cb_data);
 }
 
 // Documented in .h file
-CListElementType CL_pop(CList list)
+void CL_foreach(CList list, CL_foreach_callback callback, void *cb_data)
 {
   assert(list);
-  struct _cl_node *popped_node = list->head;
-
-  if (popped_node == NULL)
-    return INVALID_RETURN;
+  CL_STAT_CALL(list, CL_API_FOREACH);
 
-  CListElementType ret = popped_node->element;
+  // if list is empty, or callback is NULL, or cb_data is NULL, do nothing
+  if (callback == NULL || _CL_current_length(list) == 0 || cb_data == NULL)
+    return;
 
-  // unlink previous head node, then free it
-  list->head = popped_node->next;
-  free(popped_node);
-  // we cannot refer to popped node any longer
+  // positions in longer lists need CL_foreach64
+  assert(_CL_current_length(list) <= INT_MAX);
 
-  list->length--;
+  if (list->ops != NULL)
+  {
+    struct _cl_foreach_int wrapped = {callback, cb_data};
+    list->ops->foreach(list, _CL_foreach_int, &wrapped);
+    return;
+  }
 
-  return ret;
+  // traverse the list with a cursor, calling the callback function for each element
+  struct _cl_cursor cursor;
+  for (_CL_cursor_init(&cursor, list); cursor.node != NULL; _CL_cursor_advance(&cursor))
+    callback((int)cursor.pos, cursor.node->element, cb_data);
 }
 
 // Documented in .h file
-void CL_append(CList list, CListElementType element)
+void CL_foreach64(CList list, CL_foreach64_callback callback, void *cb_data)
 {
   assert(list);
+  CL_STAT_CALL(list, CL_API_FOREACH);
 
-  // new node to append - its next pointer should be NULL
-  struct _cl_node *new_node = _CL_new_node(element, NULL);
-
-  // when appending to an empty list, the new node becomes the head
-  if (list->head == NULL)
-    list->head = new_node;
+  // as for CL_foreach, do nothing if the list is empty, or callback is
+  // NULL, or cb_data is NULL
+  if (callback == NULL || _CL_current_length(list) == 0 || cb_data == NULL)
+    return;
 
-  else
+  if (list->ops != NULL)
   {
-    // otherwise, traverse the list until we find the last node
-    struct _cl_node *this_node = list->head;
-    while (this_node->next != NULL)
-      this_node = this_node->next;
-
-    // then append the new node to the end of the list
-    this_node->next = new_node;
+    list->ops->foreach(list, callback, cb_data);
+    return;
   }
 
-  // increment the length of the list
-  list->length++;
+  struct _cl_cursor cursor;
+  for (_CL_cursor_init(&cursor, list); cursor.node != NULL; _CL_cursor_advance(&cursor))
+    callback((size_t)cursor.pos, cursor.node->element, cb_data);
 }
 
-// Documented in .h file
-CListElementType CL_nth(CList list, int pos)
+// A job for _CL_foreach_segment. Segment s covers positions
+// [segments[s].pos, segments[s+1].pos).
+struct _cl_foreach_job
 {
-  assert(list);
-
-  // bounds check - if pos is negative or out of bounds, it's an error
-  if (pos < -list->length || pos >= list->length)
-    return INVALID_RETURN;
+  CL_foreach_callback callback;
+  void *cb_data;
+  CListElementType *elements; // copy of a backend list's elements, or NULL
+  struct _cl_foreach_segment
+  {
+    struct _cl_node *node; // first node of the segment (linked lists)
+    ptrdiff_t pos;         // position of the segment's first element
+  } * segments;
+};
 
-  // convert negative pos to positive by counting from the end of the list
-  if (pos < 0)
-    pos = list->length + pos;
+/*
+ * Task of CL_parallel_foreach: call the callback for each element of
+ * one segment
+ */
+static void
+_CL_foreach_segment(void *data, int task)
+{
+  struct _cl_foreach_job *job = (struct _cl_foreach_job *)data;
+  ptrdiff_t end = job->segments[task + 1].pos;
 
-  // traverse the list until we find the node at position pos
-  struct _cl_node *this_node = list->head;
-  while (pos > 0 && this_node != NULL)
+  if (job->elements != NULL)
   {
-    this_node = this_node->next;
-    pos--;
+    for (ptrdiff_t pos = job->segments[task].pos; pos < end; pos++)
+      job->callback((int)pos, job->elements[pos], job->cb_data);
+    return;
   }
 
-  // if this_node is NULL, we are at the end of the list
-  if (this_node == NULL)
-    return INVALID_RETURN;
-
-  // otherwise, this_node points to the node at position pos
-  return this_node->element;
+  struct _cl_node *node = job->segments[task].node;
+  for (ptrdiff_t pos = job->segments[task].pos; pos < end; pos++, node = node->next)
+    job->callback((int)pos, node->element, job->cb_data);
 }
 
 // Documented in .h file
-bool CL_insert(CList list, CListElementType element, int pos)
+void CL_parallel_foreach(CList list, CL_foreach_callback callback, void *cb_data, int nthreads)
 {
   assert(list);
 
-  // convert negative pos to positive by counting from the end of the list
-  if (pos < 0)
-    pos = list->length + pos + 1;
-
-  // bounds check - if pos is negative or out of bounds, it's an error
-  if (pos < 0 || pos > list->length)
-    return false;
+  // as for CL_foreach, do nothing if the list is empty, or callback
+  // is NULL, or cb_data is NULL
+  ptrdiff_t length = _CL_current_length(list);
+  if (callback == NULL || length == 0 || cb_data == NULL)
+    return;
+  assert(length <= INT_MAX);
 
-  // If pos is 0, just push the element onto the list
-  if (pos == 0)
+  int num_threads = _CL_workers_threads(nthreads);
+  if (num_threads == 1)
   {
-    CL_push(list, element);
-    return true;
+    CL_foreach(list, callback, cb_data);
+    return;
   }
+  CL_STAT_CALL(list, CL_API_FOREACH);
 
-  struct _cl_node *this_node = list->head;
+  struct _cl_foreach_job job = {callback, cb_data, NULL, NULL};
 
-  // traverse the list until we find the node at position pos-1
-  while (pos > 1 && this_node != NULL)
+  // the alternative backends have no nodes to start a segment from, so
+  // their elements are copied out first
+  if (list->ops != NULL)
   {
-    this_node = this_node->next;
-    pos--;
+    job.elements = (CListElementType *)malloc((size_t)length * sizeof(CListElementType));
+    assert(job.elements);
+    length = (ptrdiff_t)_CL_to_array(list, job.elements, (size_t)length);
   }
 
-  // If this_node is NULL, we are at the end of the list
-  if (this_node == NULL)
-    return false;
+  int num_segments = num_threads * CL_SEGMENTS_PER_THREAD;
+  if (num_segments > length)
+    num_segments = (int)length;
+
+  job.segments = malloc((size_t)(num_segments + 1) * sizeof(job.segments[0]));
+  assert(job.segments);
 
-  // Otherwise, this_node points to the this_node at position pos-1
-  this_node->next = _CL_new_node(element, this_node->next);
+  // find where each segment starts in a single walk
+  struct _cl_node *node = list->head;
+  ptrdiff_t pos = 0;
+  for (int s = 0; s < num_segments; s++)
+  {
+    ptrdiff_t start = length * s / num_segments;
+    if (job.elements == NULL)
+      for (; pos < start; pos++)
+        node = node->next;
+
+    job.segments[s].node = node;
+    job.segments[s].pos = start;
+  }
+  job.segments[num_segments].pos = length;
 
-  // Increment the length of the list
-  list->length++;
+  _CL_workers_run(num_threads, num_segments, _CL_foreach_segment, &job);
 
-  return true;
+  free(job.segments);
+  free(job.elements);
 }
 
 // Documented in .h file
-CListElementType CL_remove(CList list, int pos)
+CLCursor CL_cursor_begin(CList list)
 {
   assert(list);
 
-  // If pos is negative, count from the end of the list
-  if (pos < 0)
-    pos = list->length + pos;
-
-  // If pos is still negative or out of bounds, it's an error
-  if (pos < 0 || pos >= list->length)
-    return INVALID_RETURN;
+  CLCursor cursor = (CLCursor)malloc(sizeof(struct _cl_cursor));
+  assert(cursor);
 
-  // If pos is 0, just pop the head of the list
-  if (pos == 0)
-    return CL_pop(list);
+  _CL_cursor_init(cursor, list);
 
-  // traverse the list until we find the node at position pos-1
-  struct _cl_node *this_node = list->head;
-  while (pos > 1 && this_node != NULL)
-  {
-    this_node = this_node->next;
-    pos--;
-  }
+  return cursor;
+}
 
-  // If this_node is NULL, we are at the end of the list
-  if (this_node == NULL)
-    return INVALID_RETURN;
+// Documented in .h file
+void CL_cursor_free(CLCursor cursor)
+{
+  free(cursor);
+}
 
-  // if this_node->next is NULL, we are at the end of the list
-  struct _cl_node *rm_node = this_node->next;
-  if (rm_node == NULL)
-    return INVALID_RETURN;
-    
+// Documented in .h file
+bool CL_cursor_at_end(CLCursor cursor)
+{
+  assert(cursor);
+  return cursor->pos >= cursor->list->length;
+}
 
-  else
-  {
-    // remove the node at position pos-1 - point current node to the node after the one we are removing
-    this_node->next = rm_node->next;
+// Documented in .h file
+int CL_cursor_pos(CLCursor cursor)
+{
+  assert(cursor);
+  return (int)cursor->pos;
+}
 
-    // Save the element to return
-    CListElementType rm_element = rm_node->element;
+// Documented in .h file
+bool CL_cursor_next(CLCursor cursor)
+{
+  assert(cursor);
 
-    // Decrement the length of the list
-    list->length--;
+  if (CL_cursor_at_end(cursor))
+    return false;
 
-    // deallocate the node we are removing
-    free(rm_node);
+  if (cursor->list->ops != NULL)
+    cursor->pos++;
+  else
+    _CL_cursor_advance(cursor);
 
-    return rm_element;
-  }
+  return true;
 }
 
 // Documented in .h file
-CList CL_copy(CList list)
+CListElementType CL_cursor_get(CLCursor cursor)
 {
-  assert(list);
+  assert(cursor);
 
-  // create a new list
-  CList list_copy = CL_new();
+  if (CL_cursor_at_end(cursor))
+    return INVALID_RETURN;
 
-  // traverse the list, appending each element to the new list
-  for (struct _cl_node *node = list->head; node != NULL; node = node->next)
-    CL_append(list_copy, node->element);
+  if (cursor->list->ops != NULL)
+    return cursor->list->ops->nth(cursor->list, cursor->pos);
 
-  // return the newly-created copy
-  return list_copy;
+  return cursor->node->element;
 }
 
 // Documented in .h file
-int CL_insert_sorted(CList list, CListElementType element)
+void CL_cursor_insert_before(CLCursor cursor, CListElementType element)
 {
-  assert(list);
-
-  // if list is empty, just push the element onto front of list
-  if (list->head == NULL)
-  {
-    CL_push(list, element);
-    return 0;
-  }
-
-  // otherwise, traverse the list until we find the first element that is
-  // greater than or equal to the element we are inserting
-  struct _cl_node *this_node = list->head;
-  int position = 0;
-  while (this_node->next != NULL && strcmp(this_node->element, element) < 0)
-  {
-    this_node = this_node->next;
-    position++;
-  }
+  assert(cursor);
+  CList list = cursor->list;
 
-  // now this_node points to the first element that is greater than or equal to
-  if (strcmp(this_node->element, element) >= 0)
-    CL_insert(list, element, position);
+  if (list->ops != NULL)
+    list->ops->insert(list, element, cursor->pos);
 
-  // now this_node points to the last element in the list, so append the new element
   else
   {
-    CL_append(list, element);
-    position = CL_length(list) - 1;
+    // link in after the node before the cursor; the new node is then
+    // the one before the cursor
+    struct _cl_node *new_node = _CL_new_node(list, element);
+    _CL_link_after(list, cursor->prev, new_node, cursor->pos);
+    cursor->prev = new_node;
   }
 
-  // return the position of the newly-inserted element
-  return position;
+  cursor->pos++;
 }
 
 // Documented in .h file
-void CL_join(CList list1, CList list2)
+CListElementType CL_cursor_remove(CLCursor cursor)
 {
-  assert(list1);
-  assert(list2);
+  assert(cursor);
+  CList list = cursor->list;
 
-  // if list1 is empty, just point it at list2
-  if (list1->head == NULL)
-  {
-    list1->head = list2->head;
-    list1->length = list2->length;
-    list2->head = NULL;
-    list2->length = 0;
-  }
+  if (CL_cursor_at_end(cursor))
+    return INVALID_RETURN;
 
-  // otherwise, traverse list1 until we find the last node
-  else
-  {
-    struct _cl_node *this_node = list1->head;
-    while (this_node->next != NULL)
-      this_node = this_node->next;
+  if (list->ops != NULL)
+    return list->ops->remove(list, cursor->pos);
 
-    // pointing the last node at the head of list2
-    this_node->next = list2->head;
-    list1->length = list1->length + list2->length;
+  // unlink the node under the cursor; the cursor moves onto the next one
+  struct _cl_node *rm_node = cursor->node;
+  CListElementType rm_element = rm_node->element;
 
-    // empty list2
-    list2->head = NULL;
-    list2->length = 0;
-  }
+  cursor->node = rm_node->next;
+  _CL_unlink(list, cursor->prev, rm_node, cursor->pos);
+  _CL_free_node(list, rm_node);
+
+  return rm_element;
 }
 
 // Documented in .h file
-void CL_reverse(CList list)
+bool CL_get_stats(CList list, CLStats *stats)
 {
   assert(list);
+  assert(stats);
 
-  // reverse if list is not empty
-  if (list->head != NULL)
+#ifdef CL_STATS
+  *stats = list->stats;
+  return true;
+#else
+  memset(stats, 0, sizeof(*stats));
+  return false;
+#endif
+}
+
+// Documented in .h file
+void CL_compact(CList list)
+{
+  assert(list);
+
+  if (list->ops != NULL)
   {
-    // keep track of previous, current and next nodes
-    struct _cl_node *prev_node = NULL;
-    struct _cl_node *next_node = NULL;
-    struct _cl_node *this_node = list->head;
+    if (list->ops->compact != NULL)
+      list->ops->compact(list);
+    return;
+  }
 
-    // traverse the list, reversing the direction of each next pointers of each node
-    while (this_node != NULL)
-    {
-      next_node = this_node->next;
-      this_node->next = prev_node;
-      prev_node = this_node;
-      this_node = next_node;
-    }
+  // an owning list's elements live inside its nodes, where the caller
+  // may still be holding on to them
+  if (list->owning || list->length == 0)
+    return;
 
-    // update head of list to point to the last node
-    list->head = prev_node;
+  // the new nodes are one block from wherever the list gets its nodes.
+  // A pool no other list uses, or a malloc list, gets a new pool of its
+  // own instead, so the old nodes can be released all at once
+  size_t n = (size_t)list->length;
+  bool new_pool = list->arena == NULL && (list->pool == NULL || list->pool->refs == 1);
+  CLNodePool old_pool = list->pool;
+  struct _cl_node *block;
+
+  if (list->arena != NULL)
+    block = (struct _cl_node *)_CL_arena_alloc(list->arena, n * sizeof(struct _cl_node));
+  else
+  {
+    if (new_pool)
+      list->pool = CL_pool_new((old_pool != NULL) ? old_pool->slab_nodes : 0);
+    block = _CL_pool_alloc_run(list->pool, n);
+  }
+  CL_STAT_ALLOC(list, n);
+
+  // copy the nodes into the block in list order, releasing the old
+  // ones on the way
+  struct _cl_node *node = list->head;
+  for (size_t i = 0; i < n; i++)
+  {
+    struct _cl_node *next_node = node->next;
+
+    block[i] = *node;
+    block[i].next = (i + 1 < n) ? &block[i + 1] : NULL;
+#ifdef CL_DOUBLY_LINKED
+    block[i].prev = (i > 0) ? &block[i - 1] : NULL;
+#endif
+
+    if (!new_pool)
+      _CL_free_node(list, node);
+    else if (old_pool == NULL)
+      free(node);
+
+    node = next_node;
+  }
+
+  if (new_pool)
+  {
+    CL_STAT_FREE(list, n);
+    if (old_pool != NULL)
+      _CL_pool_release(old_pool);
   }
+
+  list->head = &block[0];
+  list->tail = &block[n - 1];
+  if (list->finger != NULL)
+    list->finger = &block[list->finger_pos];
 }
 
 // Documented in .h file
-void CL_foreach(CList list, CL_foreach_callback callback, void *cb_data)
+double CL_fragmentation(CList list)
 {
   assert(list);
 
-  // if list is empty, or callback is NULL, or cb_data is NULL, do nothing
-  if (callback == NULL || list->head == NULL || cb_data == NULL)
-    return;
+  if (list->ops != NULL)
+    return (list->ops->fragmentation != NULL) ? list->ops->fragmentation(list) : 0.0;
 
-  // traverse the list, calling the callback function for each element if it is not NULL
-  int position = 0;
-  for (struct _cl_node *this_node = list->head; this_node != NULL; this_node = this_node->next)
-  {
-    callback(position, this_node->element, cb_data);
-    position++;
-  }
-}
\ No newline at end of file
+  if (list->length < 2)
+    return 0.0;
+
+  ptrdiff_t scattered = 0;
+  for (struct _cl_node *node = list->head; node->next != NULL; node = node->next)
+    if (node->next != node + 1)
+      scattered++;
+
+  return (double)scattered / (double)(list->length - 1);
+}
@@ -10,6 +10,8 @@
 
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
 
 // struct _clist is defined in .c file
 typedef struct _clist *CList;
@@ -33,7 +35,282 @@ CList CL_new();
 
 
 /*
- * Destroy a list, calling free() on all malloc'd memory.
+ * Create a new owning CList. CL_push, CL_append, CL_insert and the
+ * other functions that add elements copy each string into the node
+ * that holds it, so the caller need not keep its strings alive, and
+ * each element takes a single allocation. Elements read from the list
+ * (CL_nth, CL_foreach, ...) point into the list's nodes and stay valid
+ * until they are removed. An element returned by CL_pop, CL_remove or
+ * CL_cursor_remove stays valid until the next removal from the list or
+ * until the list is freed. Copies of the list (CL_copy) are owning
+ * too.
+ *
+ * An owning list may only be joined (CL_join) onto another owning
+ * list, or onto an empty list created with CL_new, which then becomes
+ * owning; a join onto any other list is refused.
+ *
+ * Parameters: None
+ * 
+ * Returns: The new list
+ */
+CList CL_new_owning();
+
+
+/*
+ * Create a new concurrent CList, for use as a stack shared between
+ * threads. Any number of threads may call CL_push, CL_pop and
+ * CL_length on the list at the same time; CL_push and CL_pop are
+ * lock-free. CL_pop returns INVALID_RETURN if the list is empty at the
+ * moment it looks. While other threads are pushing and popping,
+ * CL_length is only a snapshot of a changing value.
+ *
+ * Every other CList function is supported too, including CL_free, but
+ * must not run at the same time as any other call on the list. Those
+ * functions walk the stack from its head, so positional access takes
+ * time proportional to the position, and CL_append and CL_join take
+ * time proportional to the length of the list.
+ *
+ * Parameters: None
+ * 
+ * Returns: The new list
+ */
+CList CL_new_concurrent();
+
+
+/*
+ * Create a new concurrent CList, for use as a FIFO queue shared
+ * between threads. Any number of producer threads may call CL_append,
+ * and any number of consumer threads CL_pop, on the list at the same
+ * time; both take constant time and are lock-free. CL_pop returns
+ * INVALID_RETURN if the list is empty at the moment it looks. While
+ * other threads are appending and popping, CL_length is only a
+ * snapshot of a changing value.
+ *
+ * Every other CList function is supported too, including CL_push and
+ * CL_free, but must not run at the same time as any other call on the
+ * list. Those functions walk the queue from its head, so positional
+ * access takes time proportional to the position.
+ *
+ * Parameters: None
+ * 
+ * Returns: The new list
+ */
+CList CL_new_concurrent_queue();
+
+
+/*
+ * Create a new CList that any number of threads may use at once, for
+ * example as a shared sorted list. Every node has a lock of its own.
+ * Operations walk the list without locking and only lock the nodes
+ * they change, checking that they are still linked before changing
+ * them, so operations on different parts of the list proceed in
+ * parallel; appends go straight to the last node. Removed nodes are
+ * freed once no operation is in progress, or by CL_free.
+ *
+ * CL_push, CL_pop, CL_append, CL_nth, CL_insert, CL_remove,
+ * CL_insert_sorted, CL_length, CL_copy, CL_to_array, CL_foreach and
+ * CL_print may all run at the same time. A position is interpreted
+ * against the list as the operation finds it, so CL_insert may return
+ * false, and CL_nth or CL_remove INVALID_RETURN, if other threads have
+ * shortened the list in the meantime. A CL_foreach callback must not
+ * call any function on the same list. Every other function, including
+ * CL_free, must not run at the same time as any other call on the
+ * list.
+ *
+ * Parameters: None
+ * 
+ * Returns: The new list
+ */
+CList CL_new_locked();
+
+
+/*
+ * Create a new CList that stores its elements in an unrolled linked
+ * list: each node holds an array of elements and is sized and aligned
+ * to a few cache lines. Nodes are split when an insertion finds them
+ * full and merged with a neighbour when removals leave them less than
+ * half full. Compared with CL_new, finding a position reads far fewer
+ * cache lines and each element needs far less memory. An unrolled
+ * list supports every CList function.
+ *
+ * Parameters: None
+ * 
+ * Returns: The new list
+ */
+CList CL_new_unrolled();
+
+
+/*
+ * Create a new CList that supports positional access in logarithmic
+ * time. Elements are kept in a balanced tree in which every node
+ * records the number of elements below it, so CL_nth, CL_insert and
+ * CL_remove take O(log n) expected time for any pos, with the same
+ * meaning of positive and negative positions as for any other list.
+ * CL_insert_sorted and CL_join also take O(log n), and CL_reverse
+ * takes constant time. An indexed list supports every CList function.
+ *
+ * Parameters: None
+ * 
+ * Returns: The new list
+ */
+CList CL_new_indexed();
+
+
+/*
+ * Create a new CList that stores its nodes compactly. The nodes live
+ * in a pair of arrays that grow as needed, one holding the elements
+ * and one the links, and each link is a 32-bit node number rather than
+ * a pointer, so a node takes 12 bytes on a 64-bit machine and needs no
+ * allocation of its own. Nodes are numbered in the order they are
+ * first used, so a list built by appending is laid out in list order.
+ * CL_free and CL_copy work on the arrays as a whole. Positional access
+ * walks the list, starting from a finger as for CL_new. A compact list
+ * holds up to 2^32 - 2 elements, and supports every CList function.
+ *
+ * Parameters: None
+ * 
+ * Returns: The new list
+ */
+CList CL_new_compact();
+
+
+// struct _cl_node_pool is defined in .c file
+typedef struct _cl_node_pool *CLNodePool;
+
+// Number of nodes carved from each slab when CL_pool_new is passed 0
+#define CL_POOL_DEFAULT_SLAB_NODES 1024
+
+// Statistics kept by a node pool; see CL_pool_stats
+typedef struct
+{
+  size_t slabs;       // slabs malloc'd by the pool
+  size_t capacity;    // nodes those slabs can hold
+  size_t in_use;      // nodes currently linked into lists
+  size_t peak_in_use; // highest value in_use has reached
+  size_t free_nodes;  // released nodes waiting to be reused
+  size_t allocs;      // node allocations served by the pool
+  size_t releases;    // nodes handed back to the pool
+} CLNodePoolStats;
+
+/*
+ * Create a new node pool. A pool allocates list nodes in large slabs
+ * and recycles released nodes, so that pushing and popping does not
+ * call malloc and free for every element. A pool may be shared by any
+ * number of lists. Pools are not thread-safe.
+ *
+ * Parameters:
+ *   slab_nodes  Number of nodes per slab, or 0 for
+ *               CL_POOL_DEFAULT_SLAB_NODES
+ *
+ * Returns: The new pool
+ */
+CLNodePool CL_pool_new(int slab_nodes);
+
+
+/*
+ * Release the caller's hold on a pool. The pool's slabs are freed once
+ * this has been called and every list created with the pool has been
+ * destroyed with CL_free, whichever happens last.
+ *
+ * Parameters:
+ *   pool   The pool
+ *
+ * Returns: None
+ */
+void CL_pool_free(CLNodePool pool);
+
+
+/*
+ * Retrieve the current statistics for a pool.
+ *
+ * Parameters:
+ *   pool   The pool
+ *   stats  Filled in with the pool's statistics
+ *
+ * Returns: None
+ */
+void CL_pool_stats(CLNodePool pool, CLNodePoolStats *stats);
+
+
+/*
+ * Create a new CList whose nodes are allocated from a pool. Copies of
+ * the list (CL_copy) use the same pool.
+ *
+ * Parameters:
+ *   pool   The pool to allocate nodes from
+ * 
+ * Returns: The new list
+ */
+CList CL_new_with_pool(CLNodePool pool);
+
+
+// struct _cl_arena is defined in .c file
+typedef struct _cl_arena *CLArena;
+
+// Size in bytes of the first block of an arena when CL_arena_new is
+// passed 0
+#define CL_ARENA_DEFAULT_BLOCK_SIZE 65536
+
+/*
+ * Create a new arena. Lists created in an arena, together with all of
+ * their nodes, are bump-allocated from a small number of large blocks
+ * and are released all at once by CL_arena_reset or CL_arena_free,
+ * however many elements they hold. Arenas are not thread-safe.
+ *
+ * Parameters:
+ *   block_size  Size in bytes of the first block, or 0 for
+ *               CL_ARENA_DEFAULT_BLOCK_SIZE. Each further block is
+ *               twice the size of the one before.
+ *
+ * Returns: The new arena
+ */
+CLArena CL_arena_new(size_t block_size);
+
+
+/*
+ * Release every list created in the arena, and all of their nodes,
+ * keeping the arena's largest block for reuse. Lists created in the
+ * arena must not be used after this call.
+ *
+ * Parameters:
+ *   arena  The arena
+ * 
+ * Returns: None
+ */
+void CL_arena_reset(CLArena arena);
+
+
+/*
+ * Destroy an arena, releasing every list created in it. Lists created
+ * in the arena must not be used after this call.
+ *
+ * Parameters:
+ *   arena  The arena
+ * 
+ * Returns: None
+ */
+void CL_arena_free(CLArena arena);
+
+
+/*
+ * Create a new CList in an arena. The list and its nodes live in the
+ * arena; CL_free on such a list takes constant time and only makes its
+ * nodes available to other lists in the arena. Copies of the list
+ * (CL_copy) are created in the same arena.
+ *
+ * Parameters:
+ *   arena  The arena to allocate from
+ * 
+ * Returns: The new list
+ */
+CList CL_new_in_arena(CLArena arena);
+
+
+/*
+ * Destroy a list, calling free() on all malloc'd memory. Nodes of a
+ * list created with CL_new_with_pool are returned to the pool in
+ * constant time instead; a list created with CL_new_in_arena is
+ * released with its arena.
  *
  * Parameters:
  *   list   The list
@@ -45,16 +322,43 @@ void CL_free(CList list);
 
 
 /*
- * Compute the length of a list
+ * Compute the length of a list. The length is kept up to date as the
+ * list changes, so this takes constant time, unless the library is
+ * built with -DCL_CHECK_LEVEL=2 (see CL_validate).
  *
  * Parameters:
  *   list   The list
  * 
+ * The list must be shorter than INT_MAX elements; for longer lists,
+ * use CL_length64.
+ *
  * Returns: The length of the list, or 0 if list is empty
  */
 int CL_length(CList list);
 
 
+/*
+ * Check the structure of a list from end to end: that its links lead
+ * from the head to the tail without looping back on themselves, and
+ * that the stored length, the tail and every other piece of
+ * bookkeeping agree with them. It makes a single pass over the list,
+ * which stops early if the links loop, and uses no extra memory.
+ * A list with a concurrent backend must not be changed by other
+ * threads during the check.
+ *
+ * Building the library with -DCL_CHECK_LEVEL=2 makes every call to
+ * CL_length assert that CL_validate succeeds. The default level, 1,
+ * only asserts cheap conditions, and level 0 turns off assertions
+ * entirely.
+ *
+ * Parameters:
+ *   list     The list
+ * 
+ * Returns: true if the list is sound, false if it is corrupt
+ */
+bool CL_validate(CList list);
+
+
 /*
  * Print the list
  *
@@ -102,6 +406,78 @@ CListElementType CL_pop(CList list);
 void CL_append(CList list, CListElementType element);
 
 
+/*
+ * Append n elements to the tail of the list, in order, so that
+ * elements[n-1] becomes the tail. This has the same effect as calling
+ * CL_append for each element, but builds all the new nodes in one
+ * pass. When the list was created with a pool or in an arena, the new
+ * nodes are allocated together as one contiguous block; a list created
+ * with CL_new allocates each node with malloc, as CL_append does.
+ *
+ * Parameters:
+ *   list       The list
+ *   elements   The elements to append
+ *   n          The number of elements
+ * 
+ * Returns: None
+ */
+void CL_append_array(CList list, const CListElementType *elements, int n);
+
+
+/*
+ * Push n elements onto the head of the list. This has the same effect
+ * as calling CL_push for elements[0], elements[1], ... in turn, so
+ * elements[n-1] becomes the head element. The new nodes are built and
+ * allocated as for CL_append_array.
+ *
+ * Parameters:
+ *   list       The list
+ *   elements   The elements to push
+ *   n          The number of elements
+ * 
+ * Returns: None
+ */
+void CL_push_array(CList list, const CListElementType *elements, int n);
+
+
+/*
+ * Insert n elements into the list at a given position, in order, so
+ * that a subsequent call to CL_nth with position pos + i returns
+ * elements[i]. pos has the same meaning as for CL_insert: pos == -1
+ * appends the elements. The new nodes are built and allocated as for
+ * CL_append_array, and the list is walked at most once.
+ *
+ * Parameters:
+ *   list       The list
+ *   elements   The elements to insert
+ *   n          The number of elements
+ *   pos        Position to perform the insert
+ * 
+ * pos must be in the range [-length-1, length] inclusive. If pos is
+ * outside this range, returns false and the list is unchanged.
+ * 
+ * Returns: true if the operation was successful, false otherwise
+ */
+bool CL_insert_array(CList list, const CListElementType *elements, int n, int pos);
+
+
+/*
+ * Copy the elements of the list, starting from the head, into an
+ * array, without modifying the list.
+ *
+ * Parameters:
+ *   list   The list
+ *   out    The array to fill
+ *   n      The capacity of out; at most n elements are copied
+ * 
+ * Returns: The number of elements copied, which is the smaller of n
+ *   and the length of the list. On a list created with CL_new_locked,
+ *   other threads may shorten the list during the copy; only the
+ *   returned number of slots of out are filled
+ */
+int CL_to_array(CList list, CListElementType *out, int n);
+
+
 /*
  * Return the Nth element, without modifying the list
  *
@@ -177,6 +553,30 @@ bool CL_insert(CList list, CListElementType element, int pos);
 CListElementType CL_remove(CList list, int pos);
 
 
+/*
+ * Report how well the list's finger has served positional access. The
+ * list remembers the node most recently found by position (the
+ * "finger"), and CL_nth, CL_insert and CL_remove start walking from it
+ * instead of from the head whenever it is closer, so that loops such
+ * as
+ *
+ *   for (int i = 0; i < CL_length(list); i++)
+ *     use(CL_nth(list, i));
+ *
+ * take O(n) rather than O(n^2) time. Accesses to the head or tail
+ * element need no walk and are not counted. Lists created with an
+ * alternative backend always report zero.
+ *
+ * Parameters:
+ *   list     The list
+ *   hits     Set to the number of walks that started from the finger
+ *   misses   Set to the number of walks that started elsewhere
+ *
+ * Returns: None
+ */
+void CL_finger_stats(CList list, size_t *hits, size_t *misses);
+
+
 /*
  * Copy the list. 
  * 
@@ -208,6 +608,49 @@ CList CL_copy(CList list);
 int CL_insert_sorted(CList list, CListElementType element);
 
 
+// A comparison function for ordering elements. Like strcmp, it must
+// return a negative value if a sorts before b, zero if they are equal
+// and a positive value if a sorts after b.
+typedef int (*CL_compare_fn)(CListElementType a, CListElementType b);
+
+/*
+ * Sort a list in place. The sort is stable: elements that compare
+ * equal keep their relative order. It takes O(n log n) time, and on
+ * lists created with CL_new, CL_new_with_pool or CL_new_in_arena it
+ * relinks the existing nodes without allocating any memory.
+ *
+ * Parameters:
+ *   list     The list
+ *   cmp      The comparison function, or NULL to sort following the
+ *            rules for the strcmp function, as CL_insert_sorted does
+ * 
+ * Returns: None
+ */
+void CL_sort(CList list, CL_compare_fn cmp);
+
+
+/*
+ * Sort a list in place like CL_sort, using several threads. The nodes
+ * are cut into one run per thread, the runs are sorted at the same
+ * time, and neighbouring runs are then merged in rounds, the merges of
+ * each round at the same time, by relinking nodes; no element is
+ * copied. The result is exactly the one CL_sort gives. cmp may be
+ * called from several threads at once. Lists too short to be worth
+ * splitting, and lists with an alternative backend, are sorted by
+ * CL_sort in the calling thread.
+ *
+ * Parameters:
+ *   list       The list
+ *   cmp        The comparison function, or NULL to sort following the
+ *              rules for the strcmp function, as CL_insert_sorted does
+ *   nthreads   The number of threads to use, including the calling
+ *              thread, or 0 to use one per CPU
+ * 
+ * Returns: None
+ */
+void CL_sort_parallel(CList list, CL_compare_fn cmp, int nthreads);
+
+
 /*
  * Join (concatenate) two lists. The contents of list2 are appended
  * to list1. After this operation, list2 will still exist, but it will
@@ -216,6 +659,10 @@ int CL_insert_sorted(CList list, CListElementType element);
  * Example: If list1 = A B C D and list2 = X Y Z, after CL_join
  * returns, list1 will contain A B C D X Y Z and list2 will be empty.
  *
+ * An owning list (CL_new_owning) can only be joined onto another
+ * owning list or an empty list created with CL_new; joining it onto
+ * any other list leaves both lists unchanged.
+ *
  * Parameters:
  *   list1     First list, which will grow in size
  *   list2     Second list, which will be destroyed.
@@ -256,5 +703,371 @@ typedef void (*CL_foreach_callback)(int pos, CListElementType element, void *cb_
 void CL_foreach(CList list, CL_foreach_callback callback, void *cb_data);
 
 
+/*
+ * Traverse the entire list like CL_foreach, but spread the calls to
+ * callback over several threads. The list is cut into segments in a
+ * single pass, and the segments are run by a pool of worker threads
+ * that is started on first use and kept for later calls; a thread that
+ * finishes its share of the segments early takes over segments from
+ * the others. Each element is passed to callback exactly once, along
+ * with its correct position, but calls are made in no particular order
+ * and at the same time as each other, so callback must be safe to call
+ * from several threads at once. The list must not be changed until
+ * CL_parallel_foreach returns.
+ *
+ * Parameters:
+ *   list       The list
+ *   callback   The function to call
+ *   cb_data    Caller data to pass to the function
+ *   nthreads   The number of threads to use, including the calling
+ *              thread, or 0 to use one per CPU
+ * 
+ * Returns: None
+ */
+void CL_parallel_foreach(CList list, CL_foreach_callback callback, void *cb_data, int nthreads);
+
+
+// struct _cl_cursor is defined in .c file
+typedef struct _cl_cursor *CLCursor;
+
+/*
+ * Create a cursor positioned on the head element of a list. A cursor
+ * can be moved forward through the list, and the list can be edited at
+ * the cursor without walking it again, so a pass that removes or
+ * inserts elements along the way takes O(n) time in total:
+ *
+ *   CLCursor c = CL_cursor_begin(list);
+ *   while (!CL_cursor_at_end(c))
+ *     if (should_drop(CL_cursor_get(c)))
+ *       CL_cursor_remove(c);
+ *     else
+ *       CL_cursor_next(c);
+ *   CL_cursor_free(c);
+ *
+ * Changing the list other than through the cursor (including through
+ * another cursor) invalidates the cursor. On lists created with an
+ * alternative backend (such as CL_new_unrolled or CL_new_indexed) each
+ * cursor operation costs one positional access on that backend.
+ *
+ * Parameters:
+ *   list   The list
+ *
+ * Returns: The new cursor, which must be destroyed with CL_cursor_free
+ */
+CLCursor CL_cursor_begin(CList list);
+
+
+/*
+ * Destroy a cursor. The list is not affected.
+ *
+ * Parameters:
+ *   cursor   The cursor
+ *
+ * Returns: None
+ */
+void CL_cursor_free(CLCursor cursor);
+
+
+/*
+ * Determine whether a cursor has moved past the last element of its
+ * list. A cursor on an empty list is always at the end.
+ *
+ * Parameters:
+ *   cursor   The cursor
+ *
+ * Returns: true if there is no element under the cursor
+ */
+bool CL_cursor_at_end(CLCursor cursor);
+
+
+/*
+ * Return the position of the element under a cursor, counting 0 as the
+ * head element. At the end of the list this is the length of the list.
+ *
+ * Parameters:
+ *   cursor   The cursor
+ *
+ * Returns: The cursor's position
+ */
+int CL_cursor_pos(CLCursor cursor);
+
+
+/*
+ * Move a cursor to the next element.
+ *
+ * Parameters:
+ *   cursor   The cursor
+ *
+ * Returns: true if the cursor moved, false if it was already at the end
+ */
+bool CL_cursor_next(CLCursor cursor);
+
+
+/*
+ * Return the element under a cursor, without modifying the list.
+ *
+ * Parameters:
+ *   cursor   The cursor
+ *
+ * Returns: The element, or INVALID_RETURN if the cursor is at the end
+ */
+CListElementType CL_cursor_get(CLCursor cursor);
+
+
+/*
+ * Insert an element into the list just before the cursor. The cursor
+ * stays on the same element, whose position increases by one. At the
+ * end of the list, this appends the element.
+ *
+ * Parameters:
+ *   cursor   The cursor
+ *   element  The element to insert
+ *
+ * Returns: None
+ */
+void CL_cursor_insert_before(CLCursor cursor, CListElementType element);
+
+
+/*
+ * Remove the element under a cursor and return it. The cursor moves
+ * onto the element that followed it, which takes the same position.
+ *
+ * Parameters:
+ *   cursor   The cursor
+ *
+ * Returns: The element that was removed, or INVALID_RETURN if the
+ *   cursor is at the end
+ */
+CListElementType CL_cursor_remove(CLCursor cursor);
+
+
+/*
+ * Save the elements of a list to a binary snapshot file, which
+ * CL_load or CL_load_mapped can read back. The file holds a table of
+ * offsets followed by all the strings stored back to back, in the byte
+ * order of this machine. The snapshot is written to path with ".tmp"
+ * appended, flushed to disk, and then renamed to path, replacing any
+ * existing file; if saving fails, an existing file is left as it was.
+ *
+ * Parameters:
+ *   list     The list
+ *   path     The file to write
+ * 
+ * Returns: true if the snapshot was saved, false otherwise, including
+ *   when an element of the list is NULL
+ */
+bool CL_save(CList list, const char *path);
+
+
+/*
+ * Load a snapshot saved by CL_save into a new owning list (see
+ * CL_new_owning), which holds its own copy of each element.
+ *
+ * Parameters:
+ *   path     The snapshot file
+ * 
+ * Returns: The new list, or NULL if the file could not be read or is
+ *   not a valid snapshot. A snapshot of INT_MAX or more elements is
+ *   rejected as not valid, since the list could not report its length
+ */
+CList CL_load(const char *path);
+
+
+/*
+ * Load a snapshot saved by CL_save by mapping the file into memory.
+ * No string is copied: the elements point straight into the mapped
+ * file and are appended from its offset table 1024 at a time with
+ * CL_append_array, so loading costs one pass over the table and one
+ * node allocation per element. The file stays mapped until the
+ * list is freed, and the list can be changed like any other. Like any
+ * element of the list, an element that has been copied or moved to
+ * another list (CL_copy, CL_join, ...) is only valid until the list is
+ * freed.
+ *
+ * Parameters:
+ *   path     The snapshot file
+ * 
+ * Returns: The new list, or NULL if the file could not be mapped or is
+ *   not a valid snapshot. As with CL_load, a snapshot of INT_MAX or
+ *   more elements is not valid
+ */
+CList CL_load_mapped(const char *path);
+
+
+/*
+ * Append each line read from a stream to the end of a list, without
+ * its newline. A last line that does not end in a newline is appended
+ * too. The stream is read in large blocks, each line is cut out of the
+ * block where it lies rather than copied, and the lines of a block are
+ * appended in one batch. The elements point into blocks that belong to
+ * the list and are freed with it, or for a list created in an arena,
+ * with the arena (an owning list copies them into its nodes as usual).
+ * An element moved or copied to another list with CL_join, CL_copy and
+ * the like still points into the first list's blocks, so it dangles
+ * once that list is freed. Reading stops at the end of the file or at
+ * a read error; lines read before an error stay in the list.
+ *
+ * Parameters:
+ *   list     The list
+ *   file     The stream to read
+ * 
+ * Returns: The number of lines appended, or -1 on a read error
+ */
+int CL_append_lines(CList list, FILE *file);
+
+
+/*
+ * Append each line read from a file descriptor to the end of a list,
+ * as CL_append_lines does for a stream.
+ *
+ * Parameters:
+ *   list     The list
+ *   fd       The file descriptor to read
+ * 
+ * Returns: The number of lines appended, or -1 on a read error
+ */
+int CL_append_lines_fd(CList list, int fd);
+
+
+// The functions whose calls CL_get_stats counts. CL_append_array is
+// counted as CL_insert_array, and CL_sort_parallel and
+// CL_parallel_foreach as CL_sort and CL_foreach.
+typedef enum
+{
+  CL_API_PUSH,
+  CL_API_POP,
+  CL_API_APPEND,
+  CL_API_PUSH_ARRAY,
+  CL_API_INSERT_ARRAY,
+  CL_API_NTH,
+  CL_API_INSERT,
+  CL_API_REMOVE,
+  CL_API_COPY,
+  CL_API_INSERT_SORTED,
+  CL_API_SORT,
+  CL_API_JOIN,
+  CL_API_REVERSE,
+  CL_API_FOREACH,
+  CL_API_COUNT
+} CLApi;
+
+// What a list has done, as reported by CL_get_stats
+typedef struct
+{
+  size_t calls[CL_API_COUNT];     // calls to each function
+  size_t traversed[CL_API_COUNT]; // nodes each function stepped over
+                                  // to find a position
+  size_t allocs;                  // nodes allocated for the list
+  size_t frees;                   // nodes released by the list
+  size_t peak_length;             // the longest the list has been
+} CLStats;
+
+/*
+ * Get the counters a list has kept since it was created, which show
+ * how it is used: how often each function was called, how many nodes
+ * the calls had to step over to find a position (the cost of searches
+ * that the finger did not save), how many nodes were allocated and
+ * released, and the longest the list has been. A function carried out
+ * by calling another one, such as CL_remove of the first element,
+ * which pops it, counts as a call to both. Nodes stepped over and
+ * allocated are only counted for lists created with CL_new,
+ * CL_new_with_pool, CL_new_in_arena or CL_new_owning.
+ *
+ * The counters are only kept when the library is built with
+ * -DCL_STATS; otherwise they cost nothing, and this function reports
+ * them all as zero.
+ *
+ * Parameters:
+ *   list     The list
+ *   stats    Set to the list's counters
+ * 
+ * Returns: true if the library keeps counters, false if it was built
+ *   without them
+ */
+bool CL_get_stats(CList list, CLStats *stats);
+
+
+/*
+ * 64-bit versions of the positional functions, for lists that may grow
+ * beyond INT_MAX elements. Lengths and positions are size_t, and
+ * positions that may count from the end of the list are ptrdiff_t,
+ * with the same meaning for negative values as in CL_nth, CL_insert
+ * and CL_remove. Otherwise each function behaves exactly like the int
+ * function it is named after, and the two kinds may be mixed freely on
+ * the same list. CL_nth, CL_insert and CL_remove work on lists of any
+ * length, for positions that fit in an int; CL_length,
+ * CL_insert_sorted and CL_foreach require lists shorter than INT_MAX
+ * elements.
+ *
+ * CL_length64       see CL_length
+ * CL_nth64          see CL_nth; pos is in [-length, length-1]
+ * CL_insert64       see CL_insert; pos is in [-length-1, length]
+ * CL_remove64       see CL_remove; pos is in [-length, length-1]
+ * CL_insert_sorted64  see CL_insert_sorted
+ * CL_foreach64      see CL_foreach
+ */
+size_t CL_length64(CList list);
+CListElementType CL_nth64(CList list, ptrdiff_t pos);
+bool CL_insert64(CList list, CListElementType element, ptrdiff_t pos);
+CListElementType CL_remove64(CList list, ptrdiff_t pos);
+size_t CL_insert_sorted64(CList list, CListElementType element);
+
+typedef void (*CL_foreach64_callback)(size_t pos, CListElementType element, void *cb_data);
+void CL_foreach64(CList list, CL_foreach64_callback callback, void *cb_data);
+
+
+/*
+ * Move a list's nodes into one contiguous block, in list order, so
+ * that walking the list reads memory front to back. After long runs of
+ * insertions and removals a list's nodes end up scattered, and every
+ * step of a walk may then miss the cache.
+ *
+ * The block comes from wherever the list gets its nodes: its arena,
+ * or its pool if other lists share it. A list with a pool of its own,
+ * or one that allocates its nodes with malloc, is given a new pool,
+ * and its old nodes are released. A malloc list therefore stops being
+ * a plain CL_new list: CL_join with another CL_new list, in either
+ * order, then moves the elements one at a time instead of relinking
+ * the nodes. Compact such lists once their joins are done, or create
+ * them with a shared pool (CL_new_with_pool) from the start so they
+ * keep joining in O(1). A compact list (CL_new_compact) is
+ * renumbered into arrays just large enough to hold it. Owning lists,
+ * whose elements live in their nodes, and the other backends are left
+ * as they are.
+ *
+ * The cost is one pass over the list and one allocation of its
+ * length in nodes, so it pays off for lists that are walked many times
+ * between bursts of changes. CL_fragmentation tells how much there is
+ * to gain; a caller may compact once it passes a threshold:
+ *
+ *   if (CL_fragmentation(list) > 0.5)
+ *     CL_compact(list);
+ *
+ * Cursors on the list are invalidated.
+ *
+ * Parameters:
+ *   list     The list
+ *
+ * Returns: None
+ */
+void CL_compact(CList list);
+
+/*
+ * Measure how far a list's nodes are from lying in list order: the
+ * share of nodes whose successor is not the next node in memory. A
+ * list just compacted with CL_compact measures 0; a list whose nodes
+ * were each allocated with malloc measures 1, since malloc leaves a
+ * header between any two of them. This takes a walk over the list.
+ *
+ * Parameters:
+ *   list     The list
+ *
+ * Returns: A value between 0 and 1; 0 for lists of fewer than two
+ *   elements and for backends other than the default and compact ones
+ */
+double CL_fragmentation(CList list);
+
+
+
 
 #endif /* _CLIST_H_ */
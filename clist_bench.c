@@ -0,0 +1,440 @@
+/*
+ * clist_bench.c
+ *
+ * Benchmarks for the CList API. Every operation is run against lists
+ * of 10, 100, ... elements, up to 10 million, and timed call by call.
+ * The results are printed as CSV, one line per operation and list
+ * size, so that runs against different versions can be diffed:
+ *
+ *   backend,api,size,ops,ops_per_sec,p50_ns,p99_ns,p999_ns
+ *
+ * ops_per_sec is the number of calls divided by the time spent in them;
+ * the percentiles are of the time taken by single calls. Both include
+ * the cost of reading the clock, some tens of nanoseconds, which
+ * dominates for the cheapest operations.
+ *
+ * With -s, the scaling of a shared list with the number of threads is
+ * measured instead: threads alternately insert a random key in sorted
+ * order and remove an element at a random position, on a list created
+ * with CL_new_locked and on a CL_new list behind one mutex. Then they
+ * alternately push and pop on a CL_new_concurrent stack, and append and
+ * pop on a CL_new_concurrent_queue queue, each against a CL_new list
+ * behind one mutex. One line is printed per list and number of threads:
+ *
+ *   list,threads,ops,ops_per_sec
+ *
+ * Usage: clist_bench [-b backend] [-n max_size] [-t seconds] [-s]
+ *   -b   linked (the default), unrolled, indexed or compact
+ *   -n   the largest list size to run, 10000000 by default
+ *   -t   the time to spend on each operation and size, 0.1 by default
+ *   -s   run the thread scaling benchmark
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "clist.h"
+
+// Number of distinct elements the lists are built from
+#define BENCH_KEYS 65536
+
+// Limit on the number of calls timed for each operation and size
+#define BENCH_MAX_OPS 1000000
+
+// Shape of the thread scaling benchmark: the largest number of
+// threads, the length the shared list is kept at, and the number of
+// operations, split between the threads
+#define BENCH_MAX_THREADS 8
+#define BENCH_SHARED_LENGTH 512
+#define BENCH_SHARED_OPS 200000
+
+static char bench_keys[BENCH_KEYS][12];
+static CList (*bench_new)(void);
+static uint64_t bench_rng = 88172645463325252ull;
+
+/*
+ * Return a pseudo-random number (xorshift64)
+ */
+static uint64_t
+_bench_random()
+{
+  bench_rng ^= bench_rng << 13;
+  bench_rng ^= bench_rng >> 7;
+  bench_rng ^= bench_rng << 17;
+  return bench_rng;
+}
+
+/*
+ * Return the current time in nanoseconds
+ */
+static inline uint64_t
+_bench_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Return a random element
+ */
+static inline const char *
+_bench_key()
+{
+  return bench_keys[_bench_random() % BENCH_KEYS];
+}
+
+/*
+ * Create a list of size random elements, sorted if asked. The elements
+ * are appended one at a time, so every backend lays its nodes out the
+ * way ordinary use would, and the list joins in O(1) with the single
+ * element lists _bench_setup_join makes
+ */
+static CList
+_bench_list(int size, bool sorted)
+{
+  CList list = bench_new();
+  for (int i = 0; i < size; i++)
+    CL_append(list, _bench_key());
+  if (sorted)
+    CL_sort(list, NULL);
+
+  return list;
+}
+
+// State shared by one operation's calls
+struct bench_case
+{
+  CList list;
+  CList other; // a list to join, or a copy to free
+  int size;
+  int pos;
+  const char *key;
+};
+
+/*
+ * The operations timed. Each one has an optional setup, run untimed
+ * before each call, the call itself, and an optional undo, run untimed
+ * after it, that keeps the list at its size when the call changes it
+ * in a way that depends on the size.
+ */
+static void _bench_push(struct bench_case *c) { CL_push(c->list, c->key); }
+static void _bench_pop(struct bench_case *c) { CL_pop(c->list); }
+static void _bench_append(struct bench_case *c) { CL_append(c->list, c->key); }
+static void _bench_nth(struct bench_case *c) { CL_nth(c->list, c->pos); }
+static void _bench_insert(struct bench_case *c) { CL_insert(c->list, c->key, c->pos); }
+static void _bench_remove(struct bench_case *c) { CL_remove(c->list, c->pos); }
+static void _bench_copy(struct bench_case *c) { c->other = CL_copy(c->list); }
+static void _bench_insert_sorted(struct bench_case *c) { c->pos = CL_insert_sorted(c->list, c->key); }
+static void _bench_join(struct bench_case *c) { CL_join(c->list, c->other); }
+static void _bench_reverse(struct bench_case *c) { CL_reverse(c->list); }
+
+static void
+_bench_count(int pos, CListElementType element, void *cb_data)
+{
+  (*(int *)cb_data)++;
+}
+
+static void
+_bench_foreach(struct bench_case *c)
+{
+  int count = 0;
+  CL_foreach(c->list, _bench_count, &count);
+}
+
+static void _bench_setup_pos(struct bench_case *c) { c->pos = _bench_random() % c->size; }
+static void _bench_setup_insert(struct bench_case *c) { c->pos = _bench_random() % (c->size + 1); }
+static void _bench_setup_pop(struct bench_case *c) { CL_push(c->list, c->key); }
+static void _bench_setup_remove(struct bench_case *c)
+{
+  // the element removed is not the one just inserted, which the finger
+  // would lead straight to
+  CL_insert(c->list, c->key, _bench_random() % (c->size + 1));
+  c->pos = _bench_random() % (c->size + 1);
+}
+static void _bench_setup_join(struct bench_case *c)
+{
+  c->other = bench_new();
+  CL_append(c->other, c->key);
+}
+
+static void _bench_undo_insert(struct bench_case *c) { CL_remove(c->list, c->pos); }
+static void _bench_undo_push(struct bench_case *c) { CL_pop(c->list); }
+static void _bench_undo_copy(struct bench_case *c) { CL_free(c->other); }
+static void _bench_undo_join(struct bench_case *c)
+{
+  CL_free(c->other);
+  CL_remove(c->list, -1);
+}
+
+struct bench_api
+{
+  const char *name;
+  void (*setup)(struct bench_case *c);
+  void (*call)(struct bench_case *c);
+  void (*undo)(struct bench_case *c);
+  bool sorted; // whether the list must be sorted
+};
+
+static const struct bench_api bench_apis[] = {
+    {"CL_push", NULL, _bench_push, _bench_undo_push, false},
+    {"CL_pop", _bench_setup_pop, _bench_pop, NULL, false},
+    // appending does not depend on the list's length, so the list is
+    // left to grow
+    {"CL_append", NULL, _bench_append, NULL, false},
+    {"CL_nth", _bench_setup_pos, _bench_nth, NULL, false},
+    {"CL_insert", _bench_setup_insert, _bench_insert, _bench_undo_insert, false},
+    {"CL_remove", _bench_setup_remove, _bench_remove, NULL, false},
+    {"CL_copy", NULL, _bench_copy, _bench_undo_copy, false},
+    {"CL_insert_sorted", NULL, _bench_insert_sorted, _bench_undo_insert, true},
+    {"CL_join", _bench_setup_join, _bench_join, _bench_undo_join, false},
+    {"CL_reverse", NULL, _bench_reverse, NULL, false},
+    {"CL_foreach", NULL, _bench_foreach, NULL, false},
+};
+
+static int
+_bench_compare_u64(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * Time one operation against a list of the given size, and print a
+ * line of results
+ */
+static void
+_bench_run(const char *backend, const struct bench_api *api, int size, double seconds)
+{
+  static uint64_t samples[BENCH_MAX_OPS];
+
+  struct bench_case c = {_bench_list(size, api->sorted), NULL, size, 0, NULL};
+  uint64_t budget = (uint64_t)(seconds * 1e9), elapsed = 0, total = 0;
+  int ops = 0;
+
+  // at least a few calls, even when a single call takes longer than
+  // the time allowed
+  while (ops < BENCH_MAX_OPS && (ops < 3 || elapsed < budget))
+  {
+    uint64_t start = _bench_now();
+
+    c.key = _bench_key();
+    if (api->setup != NULL)
+      api->setup(&c);
+
+    uint64_t before = _bench_now();
+    api->call(&c);
+    uint64_t took = _bench_now() - before;
+
+    if (api->undo != NULL)
+      api->undo(&c);
+
+    samples[ops++] = took;
+    total += took;
+    elapsed += _bench_now() - start;
+  }
+
+  qsort(samples, ops, sizeof(samples[0]), _bench_compare_u64);
+  printf("%s,%s,%d,%d,%.0f,%llu,%llu,%llu\n", backend, api->name, size, ops,
+         (total > 0) ? ops * 1e9 / total : 0.0,
+         (unsigned long long)samples[(int)(ops * 0.5)],
+         (unsigned long long)samples[(int)(ops * 0.99)],
+         (unsigned long long)samples[(int)(ops * 0.999)]);
+  fflush(stdout);
+
+  CL_free(c.list);
+}
+
+// One thread of the thread scaling benchmark
+struct bench_worker
+{
+  CList list;
+  pthread_mutex_t *lock; // taken around each operation, if not NULL
+  bool fifo;             // append rather than push (_bench_stack_worker)
+  int num_ops;
+  unsigned seed;
+};
+
+/*
+ * Thread body for the thread scaling benchmark: alternately inserts a
+ * random key in sorted order and removes an element at a random
+ * position, keeping the length of the list steady
+ */
+static void *
+_bench_shared_worker(void *arg)
+{
+  struct bench_worker *worker = (struct bench_worker *)arg;
+
+  for (int i = 0; i < worker->num_ops; i += 2)
+  {
+    const char *key = bench_keys[rand_r(&worker->seed) % BENCH_KEYS];
+    int pos = rand_r(&worker->seed) % BENCH_SHARED_LENGTH;
+
+    if (worker->lock != NULL)
+      pthread_mutex_lock(worker->lock);
+    CL_insert_sorted(worker->list, key);
+    if (worker->lock != NULL)
+      pthread_mutex_unlock(worker->lock);
+
+    if (worker->lock != NULL)
+      pthread_mutex_lock(worker->lock);
+    CL_remove(worker->list, pos);
+    if (worker->lock != NULL)
+      pthread_mutex_unlock(worker->lock);
+  }
+
+  return NULL;
+}
+
+/*
+ * Thread body for the stack and queue rows of the thread scaling
+ * benchmark: alternately pushes (or appends) a random key and pops
+ * one, the way the concurrent backends are meant to be used
+ */
+static void *
+_bench_stack_worker(void *arg)
+{
+  struct bench_worker *worker = (struct bench_worker *)arg;
+
+  for (int i = 0; i < worker->num_ops; i += 2)
+  {
+    const char *key = bench_keys[rand_r(&worker->seed) % BENCH_KEYS];
+
+    if (worker->lock != NULL)
+      pthread_mutex_lock(worker->lock);
+    if (worker->fifo)
+      CL_append(worker->list, key);
+    else
+      CL_push(worker->list, key);
+    if (worker->lock != NULL)
+      pthread_mutex_unlock(worker->lock);
+
+    if (worker->lock != NULL)
+      pthread_mutex_lock(worker->lock);
+    CL_pop(worker->list);
+    if (worker->lock != NULL)
+      pthread_mutex_unlock(worker->lock);
+  }
+
+  return NULL;
+}
+
+/*
+ * Time BENCH_SHARED_OPS operations on a shared list from 1, 2, 4, ...
+ * threads, each running body, and print a line of results for each
+ * number of threads
+ */
+static void
+_bench_scaling(const char *name, CList list, pthread_mutex_t *lock, void *(*body)(void *),
+               bool fifo)
+{
+  for (int i = 0; i < BENCH_SHARED_LENGTH; i++)
+  {
+    if (body == _bench_shared_worker)
+      CL_insert_sorted(list, _bench_key());
+    else if (fifo)
+      CL_append(list, _bench_key());
+    else
+      CL_push(list, _bench_key());
+  }
+
+  for (int num_threads = 1; num_threads <= BENCH_MAX_THREADS; num_threads *= 2)
+  {
+    struct bench_worker workers[BENCH_MAX_THREADS];
+    pthread_t threads[BENCH_MAX_THREADS];
+
+    uint64_t start = _bench_now();
+    for (int t = 0; t < num_threads; t++)
+    {
+      workers[t].list = list;
+      workers[t].lock = lock;
+      workers[t].fifo = fifo;
+      workers[t].num_ops = BENCH_SHARED_OPS / num_threads;
+      workers[t].seed = 1000 + t;
+      pthread_create(&threads[t], NULL, body, &workers[t]);
+    }
+    for (int t = 0; t < num_threads; t++)
+      pthread_join(threads[t], NULL);
+    uint64_t took = _bench_now() - start;
+
+    printf("%s,%d,%d,%.0f\n", name, num_threads, BENCH_SHARED_OPS, BENCH_SHARED_OPS * 1e9 / took);
+    fflush(stdout);
+  }
+
+  CL_free(list);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *backend = "linked";
+  int max_size = 10000000;
+  double seconds = 0.1;
+  bool scaling = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "b:n:t:s")) != -1)
+  {
+    switch (opt)
+    {
+    case 'b':
+      backend = optarg;
+      break;
+    case 'n':
+      max_size = atoi(optarg);
+      break;
+    case 't':
+      seconds = atof(optarg);
+      break;
+    case 's':
+      scaling = true;
+      break;
+    default:
+      fprintf(stderr, "Usage: %s [-b linked|unrolled|indexed|compact] [-n max_size] [-t seconds] [-s]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (strcmp(backend, "linked") == 0)
+    bench_new = CL_new;
+  else if (strcmp(backend, "unrolled") == 0)
+    bench_new = CL_new_unrolled;
+  else if (strcmp(backend, "indexed") == 0)
+    bench_new = CL_new_indexed;
+  else if (strcmp(backend, "compact") == 0)
+    bench_new = CL_new_compact;
+  else
+  {
+    fprintf(stderr, "%s: unknown backend %s\n", argv[0], backend);
+    return 1;
+  }
+
+  for (int i = 0; i < BENCH_KEYS; i++)
+    snprintf(bench_keys[i], sizeof(bench_keys[i]), "%08llx", (unsigned long long)_bench_random());
+
+  if (scaling)
+  {
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+    printf("list,threads,ops,ops_per_sec\n");
+    _bench_scaling("fine-grained", CL_new_locked(), NULL, _bench_shared_worker, false);
+    _bench_scaling("global-mutex", CL_new(), &lock, _bench_shared_worker, false);
+    _bench_scaling("lock-free-stack", CL_new_concurrent(), NULL, _bench_stack_worker, false);
+    _bench_scaling("mutex-stack", CL_new(), &lock, _bench_stack_worker, false);
+    _bench_scaling("lock-free-queue", CL_new_concurrent_queue(), NULL, _bench_stack_worker, true);
+    _bench_scaling("mutex-queue", CL_new(), &lock, _bench_stack_worker, true);
+    return 0;
+  }
+
+  printf("backend,api,size,ops,ops_per_sec,p50_ns,p99_ns,p999_ns\n");
+  for (long size = 10; size <= max_size; size *= 10)
+    for (int a = 0; a < sizeof(bench_apis) / sizeof(bench_apis[0]); a++)
+      _bench_run(backend, &bench_apis[a], (int)size, seconds);
+
+  return 0;
+}
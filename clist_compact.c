@@ -0,0 +1,559 @@
+/*
+ * clist_compact.c
+ *
+ * Compact backend for CList. Nodes live in two growable arrays, one of
+ * elements and one of links, and a link is the 32-bit number of the
+ * next node rather than a pointer. On a 64-bit machine a node takes 12
+ * bytes and no allocation of its own, where a node of CL_new takes 16
+ * bytes plus malloc's header. Nodes are numbered in the order they are
+ * first used, so a list built by appending lies in memory in list
+ * order, and walking it reads the arrays front to back. Freeing a list
+ * frees two arrays, and copying one copies them.
+ *
+ * Released nodes are chained through their links onto a free list and
+ * reused before the arrays grow. The arrays double in size when they
+ * fill up; nodes are found by number, so moving them costs nothing
+ * beyond the copy.
+ *
+ * Inserting and removing in the middle leaves the list out of order
+ * in the arrays, with released nodes between; CL_compact renumbers the
+ * nodes in list order into arrays just large enough to hold them.
+ *
+ * Like the linked backend, the list keeps a finger: the node most
+ * recently found by position, which the next search may start from.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+
+#include "clist.h"
+#include "clist_internal.h"
+
+// Node number 0 is never handed out, so that it can mean "no node"
+#define CLA_NIL 0
+
+// Number of nodes the arrays are first allocated with
+#define CLA_FIRST_CAPACITY 64
+
+struct _cl_compact
+{
+  CListElementType *elements; // elements[i] is the element of node i
+  uint32_t *next;             // next[i] is the number of the node after node i
+  uint32_t capacity;          // nodes the arrays have room for
+  uint32_t used;              // nodes handed out so far, counting node 0
+  uint32_t free_head;         // released nodes, chained through next
+  uint32_t head;
+  uint32_t tail;
+
+  // the node most recently found by position, or CLA_NIL
+  uint32_t finger;
+  ptrdiff_t finger_pos;
+};
+
+#define COMPACT(list) ((struct _cl_compact *)(list)->impl)
+
+/*
+ * Make room in the arrays for n more nodes than have been handed out
+ *
+ * Parameters:
+ *   ca   The list's backend state
+ *   n    The number of nodes
+ *
+ * Returns: None
+ */
+static void
+_CLA_reserve(struct _cl_compact *ca, uint32_t n)
+{
+  uint64_t needed = (uint64_t)ca->used + n;
+  if (needed <= ca->capacity)
+    return;
+
+  // node numbers are 32 bits wide
+  assert(needed <= UINT32_MAX);
+
+  uint64_t capacity = (ca->capacity > 0) ? ca->capacity : CLA_FIRST_CAPACITY;
+  while (capacity < needed)
+    capacity *= 2;
+  if (capacity > UINT32_MAX)
+    capacity = UINT32_MAX;
+
+  ca->elements = (CListElementType *)realloc(ca->elements, capacity * sizeof(CListElementType));
+  ca->next = (uint32_t *)realloc(ca->next, capacity * sizeof(uint32_t));
+  assert(ca->elements && ca->next);
+
+  ca->capacity = (uint32_t)capacity;
+}
+
+/*
+ * Take a node, reusing a released one if there is one
+ *
+ * Parameters:
+ *   ca        The list's backend state
+ *   element   The element for the node
+ *
+ * Returns: The number of the node; its link is not initialized
+ */
+static uint32_t
+_CLA_new_node(struct _cl_compact *ca, CListElementType element)
+{
+  uint32_t node = ca->free_head;
+
+  if (node != CLA_NIL)
+    ca->free_head = ca->next[node];
+  else
+  {
+    _CLA_reserve(ca, 1);
+    node = ca->used++;
+  }
+
+  ca->elements[node] = element;
+
+  return node;
+}
+
+/*
+ * Link a new node holding element into the list directly after prev,
+ * keeping head, tail, length and the finger up to date
+ *
+ * Parameters:
+ *   list      The list
+ *   prev      The node to link after, or CLA_NIL to link at the head
+ *   element   The element for the new node
+ *   pos       The position the new node takes in the list
+ *
+ * Returns: None
+ */
+static void
+_CLA_link_after(CList list, uint32_t prev, CListElementType element, ptrdiff_t pos)
+{
+  struct _cl_compact *ca = COMPACT(list);
+  uint32_t node = _CLA_new_node(ca, element);
+  uint32_t next = (prev == CLA_NIL) ? ca->head : ca->next[prev];
+
+  ca->next[node] = next;
+  if (prev == CLA_NIL)
+    ca->head = node;
+  else
+    ca->next[prev] = node;
+
+  if (next == CLA_NIL)
+    ca->tail = node;
+
+  if (ca->finger != CLA_NIL && ca->finger_pos >= pos)
+    ca->finger_pos++;
+
+  list->length++;
+}
+
+/*
+ * Unlink the node after prev from the list and release it, keeping
+ * head, tail, length and the finger up to date
+ *
+ * Parameters:
+ *   list   The list
+ *   prev   The node before the one to unlink, or CLA_NIL to unlink
+ *          the head
+ *   pos    The position of the node to unlink
+ *
+ * Returns: The element of the unlinked node
+ */
+static CListElementType
+_CLA_unlink_after(CList list, uint32_t prev, ptrdiff_t pos)
+{
+  struct _cl_compact *ca = COMPACT(list);
+  uint32_t node = (prev == CLA_NIL) ? ca->head : ca->next[prev];
+  uint32_t next = ca->next[node];
+
+  if (prev == CLA_NIL)
+    ca->head = next;
+  else
+    ca->next[prev] = next;
+
+  if (next == CLA_NIL)
+    ca->tail = prev;
+
+  // a finger on the unlinked node falls back to its predecessor, and
+  // one after it moves down one position
+  if (ca->finger == node)
+  {
+    ca->finger = prev;
+    ca->finger_pos = pos - 1;
+  }
+  else if (ca->finger != CLA_NIL && ca->finger_pos > pos)
+    ca->finger_pos--;
+
+  list->length--;
+
+  ca->next[node] = ca->free_head;
+  ca->free_head = node;
+
+  return ca->elements[node];
+}
+
+/*
+ * Find the node at a given position, walking from whichever of the
+ * head and the finger is closer; the node found becomes the finger
+ *
+ * Parameters:
+ *   list   The list
+ *   pos    Position of the node, in the range [0, length-1]
+ *
+ * Returns: The number of the node at position pos
+ */
+static uint32_t
+_CLA_node_at(CList list, ptrdiff_t pos)
+{
+  struct _cl_compact *ca = COMPACT(list);
+
+  if (pos == list->length - 1)
+    return ca->tail;
+
+  uint32_t node = ca->head;
+  ptrdiff_t distance = pos;
+  if (ca->finger != CLA_NIL && pos >= ca->finger_pos && pos - ca->finger_pos < distance)
+  {
+    node = ca->finger;
+    distance = pos - ca->finger_pos;
+  }
+
+  for (; distance > 0; distance--)
+    node = ca->next[node];
+
+  ca->finger = node;
+  ca->finger_pos = pos;
+
+  return node;
+}
+
+/*
+ * Return the node before a position, in the range [0, length], which
+ * is CLA_NIL for position 0
+ */
+static inline uint32_t
+_CLA_before(CList list, ptrdiff_t pos)
+{
+  return (pos == 0) ? CLA_NIL : _CLA_node_at(list, pos - 1);
+}
+
+/*
+ * The operations below implement struct _cl_ops for compact lists;
+ * see clist_internal.h
+ */
+
+static void
+_CLA_free(CList list)
+{
+  struct _cl_compact *ca = COMPACT(list);
+
+  free(ca->elements);
+  free(ca->next);
+  free(ca);
+}
+
+static bool
+_CLA_check(CList list)
+{
+  struct _cl_compact *ca = COMPACT(list);
+
+  // no more nodes than the list's length can be reached, unless the
+  // links form a cycle or the length is wrong
+  ptrdiff_t len = 0;
+  uint32_t last = CLA_NIL;
+  bool finger_found = false;
+  for (uint32_t node = ca->head; node != CLA_NIL; node = ca->next[node])
+  {
+    if (node >= ca->used || len == list->length)
+      return false;
+    if (node == ca->finger)
+      finger_found = (len == ca->finger_pos);
+    last = node;
+    len++;
+  }
+  if (len != list->length || last != ca->tail || (ca->finger != CLA_NIL && !finger_found))
+    return false;
+
+  // every other node handed out has been released
+  uint32_t released = 0, spare = ca->used - 1 - (uint32_t)len;
+  for (uint32_t node = ca->free_head; node != CLA_NIL; node = ca->next[node])
+    if (node >= ca->used || ++released > spare)
+      return false;
+
+  return released == spare;
+}
+
+static void
+_CLA_push(CList list, CListElementType element)
+{
+  _CLA_link_after(list, CLA_NIL, element, 0);
+}
+
+static CListElementType
+_CLA_pop(CList list)
+{
+  return _CLA_unlink_after(list, CLA_NIL, 0);
+}
+
+static void
+_CLA_append(CList list, CListElementType element)
+{
+  _CLA_link_after(list, COMPACT(list)->tail, element, list->length);
+}
+
+static CListElementType
+_CLA_nth(CList list, ptrdiff_t pos)
+{
+  return COMPACT(list)->elements[_CLA_node_at(list, pos)];
+}
+
+static bool
+_CLA_insert(CList list, CListElementType element, ptrdiff_t pos)
+{
+  _CLA_link_after(list, _CLA_before(list, pos), element, pos);
+  return true;
+}
+
+static CListElementType
+_CLA_remove(CList list, ptrdiff_t pos)
+{
+  return _CLA_unlink_after(list, _CLA_before(list, pos), pos);
+}
+
+static CList
+_CLA_copy(CList list)
+{
+  struct _cl_compact *ca = COMPACT(list);
+  CList list_copy = CL_new_compact();
+  struct _cl_compact *copy = COMPACT(list_copy);
+
+  // node numbers mean the same in the copy, so the arrays are copied
+  // as they are, released nodes and all
+  if (ca->used > 1)
+  {
+    copy->elements = (CListElementType *)malloc(ca->used * sizeof(CListElementType));
+    copy->next = (uint32_t *)malloc(ca->used * sizeof(uint32_t));
+    assert(copy->elements && copy->next);
+
+    memcpy(copy->elements, ca->elements, ca->used * sizeof(CListElementType));
+    memcpy(copy->next, ca->next, ca->used * sizeof(uint32_t));
+    copy->capacity = ca->used;
+  }
+
+  copy->used = ca->used;
+  copy->free_head = ca->free_head;
+  copy->head = ca->head;
+  copy->tail = ca->tail;
+  list_copy->length = list->length;
+
+  return list_copy;
+}
+
+static ptrdiff_t
+_CLA_insert_sorted(CList list, CListElementType element)
+{
+  struct _cl_compact *ca = COMPACT(list);
+
+  // an element that sorts after the tail is appended without a walk
+  if (ca->tail == CLA_NIL || strcmp(ca->elements[ca->tail], element) < 0)
+  {
+    _CLA_append(list, element);
+    return list->length - 1;
+  }
+
+  // otherwise find the first element that is greater than or equal to
+  // the new one; the tail guarantees there is one
+  uint32_t prev = CLA_NIL;
+  uint32_t node = ca->head;
+  ptrdiff_t position = 0;
+  while (strcmp(ca->elements[node], element) < 0)
+  {
+    prev = node;
+    node = ca->next[node];
+    position++;
+  }
+
+  _CLA_link_after(list, prev, element, position);
+
+  return position;
+}
+
+static void
+_CLA_join(CList list1, CList list2)
+{
+  struct _cl_compact *c1 = COMPACT(list1);
+  struct _cl_compact *c2 = COMPACT(list2);
+
+  // node i of list2 becomes node i + offset of list1: the arrays of
+  // list2 are copied onto the end of those of list1, renumbering the
+  // links on the way
+  uint32_t offset = c1->used - 1;
+  uint32_t moved = c2->used - 1;
+  _CLA_reserve(c1, moved);
+
+  memcpy(c1->elements + c1->used, c2->elements + 1, moved * sizeof(CListElementType));
+  for (uint32_t i = 1; i <= moved; i++)
+    c1->next[offset + i] = (c2->next[i] == CLA_NIL) ? CLA_NIL : c2->next[i] + offset;
+  c1->used += moved;
+
+  // link list2's nodes in after the tail of list1
+  if (c1->tail == CLA_NIL)
+    c1->head = c2->head + offset;
+  else
+    c1->next[c1->tail] = c2->head + offset;
+  c1->tail = c2->tail + offset;
+  list1->length += list2->length;
+
+  // and hand the nodes list2 had released to list1's free list
+  if (c2->free_head != CLA_NIL)
+  {
+    uint32_t last = c2->free_head + offset;
+    while (c1->next[last] != CLA_NIL)
+      last = c1->next[last];
+    c1->next[last] = c1->free_head;
+    c1->free_head = c2->free_head + offset;
+  }
+
+  // empty list2
+  free(c2->elements);
+  free(c2->next);
+  c2->elements = NULL;
+  c2->next = NULL;
+  c2->capacity = 0;
+  c2->used = 1;
+  c2->free_head = CLA_NIL;
+  c2->head = CLA_NIL;
+  c2->tail = CLA_NIL;
+  c2->finger = CLA_NIL;
+  list2->length = 0;
+}
+
+static void
+_CLA_reverse(CList list)
+{
+  struct _cl_compact *ca = COMPACT(list);
+
+  uint32_t prev = CLA_NIL;
+  uint32_t node = ca->head;
+  while (node != CLA_NIL)
+  {
+    uint32_t next = ca->next[node];
+    ca->next[node] = prev;
+    prev = node;
+    node = next;
+  }
+
+  ca->tail = ca->head;
+  ca->head = prev;
+
+  // the finger's node stays the same, at the mirrored position
+  ca->finger_pos = list->length - 1 - ca->finger_pos;
+}
+
+static void
+_CLA_foreach(CList list, CL_foreach64_callback callback, void *cb_data)
+{
+  struct _cl_compact *ca = COMPACT(list);
+
+  size_t position = 0;
+  for (uint32_t node = ca->head; node != CLA_NIL; node = ca->next[node])
+    callback(position++, ca->elements[node], cb_data);
+}
+
+static void
+_CLA_compact(CList list)
+{
+  struct _cl_compact *ca = COMPACT(list);
+  uint32_t n = (uint32_t)list->length;
+
+  // node i of the new arrays is the node at position i - 1, so the
+  // list lies in memory in list order with no released nodes between
+  CListElementType *elements = NULL;
+  uint32_t *next = NULL;
+  if (n > 0)
+  {
+    elements = (CListElementType *)malloc(((size_t)n + 1) * sizeof(CListElementType));
+    next = (uint32_t *)malloc(((size_t)n + 1) * sizeof(uint32_t));
+    assert(elements && next);
+
+    uint32_t node = ca->head;
+    for (uint32_t i = 1; i <= n; i++)
+    {
+      elements[i] = ca->elements[node];
+      next[i] = (i < n) ? i + 1 : CLA_NIL;
+      node = ca->next[node];
+    }
+  }
+
+  free(ca->elements);
+  free(ca->next);
+  ca->elements = elements;
+  ca->next = next;
+  ca->capacity = (n > 0) ? n + 1 : 0;
+  ca->used = n + 1;
+  ca->free_head = CLA_NIL;
+  ca->head = (n > 0) ? 1 : CLA_NIL;
+  ca->tail = n;
+  if (ca->finger != CLA_NIL)
+    ca->finger = (uint32_t)ca->finger_pos + 1;
+}
+
+static double
+_CLA_fragmentation(CList list)
+{
+  struct _cl_compact *ca = COMPACT(list);
+
+  if (list->length < 2)
+    return 0.0;
+
+  ptrdiff_t scattered = 0;
+  for (uint32_t node = ca->head; ca->next[node] != CLA_NIL; node = ca->next[node])
+    if (ca->next[node] != node + 1)
+      scattered++;
+
+  return (double)scattered / (double)(list->length - 1);
+}
+
+const struct _cl_ops _CL_compact_ops = {
+    .free = _CLA_free,
+    .check = _CLA_check,
+    .push = _CLA_push,
+    .pop = _CLA_pop,
+    .append = _CLA_append,
+    .nth = _CLA_nth,
+    .insert = _CLA_insert,
+    .remove = _CLA_remove,
+    .copy = _CLA_copy,
+    .insert_sorted = _CLA_insert_sorted,
+    .join = _CLA_join,
+    .reverse = _CLA_reverse,
+    .foreach = _CLA_foreach,
+    .compact = _CLA_compact,
+    .fragmentation = _CLA_fragmentation,
+};
+
+// Documented in .h file
+CList CL_new_compact()
+{
+  CList list = CL_new();
+
+  struct _cl_compact *ca = (struct _cl_compact *)malloc(sizeof(struct _cl_compact));
+  assert(ca);
+
+  ca->elements = NULL;
+  ca->next = NULL;
+  ca->capacity = 0;
+  ca->used = 1;
+  ca->free_head = CLA_NIL;
+  ca->head = CLA_NIL;
+  ca->tail = CLA_NIL;
+  ca->finger = CLA_NIL;
+  ca->finger_pos = 0;
+
+  list->ops = &_CL_compact_ops;
+  list->impl = ca;
+
+  return list;
+}
@@ -0,0 +1,755 @@
+/*
+ * clist_concurrent.c
+ *
+ * Concurrent backends for CList: a stack (CL_new_concurrent) and a
+ * FIFO queue (CL_new_concurrent_queue), neither of which takes a lock.
+ *
+ * The stack is a Treiber stack: CL_push and CL_pop replace the head
+ * with a single compare-and-swap, so any number of threads may push
+ * and pop at once. The queue is a Michael-Scott queue: the list starts
+ * with a dummy node, CL_append links a node after the last one and
+ * then swings the tail to it, and CL_pop swings the head from the
+ * dummy to the first element's node, which becomes the new dummy. A
+ * thread that finds the tail lagging behind helps move it along, so
+ * any number of producers and consumers may append and pop at once.
+ *
+ * Links are 32-bit node numbers rather than pointers, which leaves
+ * room in each 64-bit link word for a tag that is incremented on every
+ * change. A thread that read a link, was delayed while other threads
+ * removed and reused the node it points to, and then tries its
+ * compare-and-swap sees a different tag and retries, which rules out
+ * the ABA problem (short of 2^32 changes while it was delayed).
+ *
+ * Nodes are never returned to malloc while the list exists: removed
+ * nodes go onto a free list, itself a tagged Treiber stack, so a
+ * thread that is still reading a node another thread has just removed
+ * reads valid (if stale) memory. Nodes live in segments that double in
+ * size and are never moved, so a node number stays valid as the list
+ * grows.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "clist.h"
+#include "clist_internal.h"
+
+// Segment s holds CLC_FIRST_SEGMENT << s nodes, so CLC_SEGMENTS
+// segments hold just under 2^31 nodes
+#define CLC_FIRST_SEGMENT 64
+#define CLC_SEGMENTS 25
+
+// Node numbers are one more than the node's index, so that 0 can mean
+// "no node"
+#define CLC_NIL 0
+
+// Link words are tagged: the low 32 bits hold a node number and the
+// high 32 bits a count of changes
+#define CLC_REF(word) ((uint32_t)(word))
+#define CLC_TAGGED(word, ref) ((((uint64_t)(word) >> 32) + 1) << 32 | (ref))
+
+#define CLC_CACHE_LINE 64
+
+struct _cl_cnode
+{
+  // the element may be read by a thread racing to remove a node that
+  // is being reused, so it is atomic too
+  _Atomic(CListElementType) element;
+  _Atomic uint64_t next; // tagged number of the next node
+};
+
+struct _cl_concurrent
+{
+  // the heads and the tail are each written by every push, pop or
+  // append, so each gets a cache line of its own
+  _Alignas(CLC_CACHE_LINE) _Atomic uint64_t head; // top of the stack, or the queue's dummy
+  _Alignas(CLC_CACHE_LINE) _Atomic uint64_t tail; // last node of the queue
+  _Alignas(CLC_CACHE_LINE) _Atomic uint64_t free_head; // released nodes
+  _Alignas(CLC_CACHE_LINE) _Atomic uint32_t carved; // nodes taken from segments
+  bool fifo; // true for a queue, false for a stack
+  _Atomic(struct _cl_cnode *) segments[CLC_SEGMENTS];
+};
+
+#define CONCURRENT(list) ((struct _cl_concurrent *)(list)->impl)
+
+/*
+ * Find the segment holding a node, and the node's offset within it
+ *
+ * Parameters:
+ *   index    The index of the node (its number minus one)
+ *   offset   Set to the offset of the node in its segment
+ *
+ * Returns: The segment number
+ */
+static inline int
+_CLC_segment(uint32_t index, uint32_t *offset)
+{
+  int s = 31 - __builtin_clz(index / CLC_FIRST_SEGMENT + 1);
+  *offset = index - CLC_FIRST_SEGMENT * ((1u << s) - 1);
+  return s;
+}
+
+/*
+ * Return the node with a given number, which must not be CLC_NIL
+ */
+static inline struct _cl_cnode *
+_CLC_node(struct _cl_concurrent *cs, uint32_t ref)
+{
+  uint32_t offset;
+  int s = _CLC_segment(ref - 1, &offset);
+  return &atomic_load_explicit(&cs->segments[s], memory_order_acquire)[offset];
+}
+
+/*
+ * Return the tagged link word of a node
+ */
+static inline uint64_t
+_CLC_next_word(struct _cl_concurrent *cs, uint32_t ref)
+{
+  return atomic_load_explicit(&_CLC_node(cs, ref)->next, memory_order_acquire);
+}
+
+/*
+ * Return the number of the node after a given one
+ */
+static inline uint32_t
+_CLC_next(struct _cl_concurrent *cs, uint32_t ref)
+{
+  return CLC_REF(_CLC_next_word(cs, ref));
+}
+
+/*
+ * Point a node at another, bumping the tag of its link
+ */
+static inline void
+_CLC_set_next(struct _cl_concurrent *cs, uint32_t ref, uint32_t next)
+{
+  atomic_store_explicit(&_CLC_node(cs, ref)->next, CLC_TAGGED(_CLC_next_word(cs, ref), next),
+                        memory_order_release);
+}
+
+/*
+ * Return the element of a node
+ */
+static inline CListElementType
+_CLC_element(struct _cl_concurrent *cs, uint32_t ref)
+{
+  return atomic_load_explicit(&_CLC_node(cs, ref)->element, memory_order_relaxed);
+}
+
+/*
+ * Push a node onto a tagged stack
+ *
+ * Parameters:
+ *   cs     The list's backend state
+ *   top    The head of the stack
+ *   ref    The number of the node to push
+ *
+ * Returns: None
+ */
+static void
+_CLC_push_ref(struct _cl_concurrent *cs, _Atomic uint64_t *top, uint32_t ref)
+{
+  uint64_t old = atomic_load_explicit(top, memory_order_relaxed);
+
+  // the release ordering publishes the node's element and link to the
+  // thread that pops it
+  do
+    _CLC_set_next(cs, ref, CLC_REF(old));
+  while (!atomic_compare_exchange_weak_explicit(top, &old, CLC_TAGGED(old, ref),
+                                                memory_order_release, memory_order_relaxed));
+}
+
+/*
+ * Pop a node from a tagged stack
+ *
+ * Parameters:
+ *   cs     The list's backend state
+ *   top    The head of the stack
+ *
+ * Returns: The number of the popped node, or CLC_NIL if the stack was
+ *   empty
+ */
+static uint32_t
+_CLC_pop_ref(struct _cl_concurrent *cs, _Atomic uint64_t *top)
+{
+  uint64_t old = atomic_load_explicit(top, memory_order_acquire);
+
+  for (;;)
+  {
+    uint32_t ref = CLC_REF(old);
+    if (ref == CLC_NIL)
+      return CLC_NIL;
+
+    // if another thread pops this node first, next may be stale, but
+    // the tag will have changed and the exchange fails
+    uint32_t next = _CLC_next(cs, ref);
+    if (atomic_compare_exchange_weak_explicit(top, &old, CLC_TAGGED(old, next),
+                                              memory_order_acquire, memory_order_acquire))
+      return ref;
+  }
+}
+
+/*
+ * Take a node for a new element, reusing a released node if there is
+ * one and otherwise carving a fresh one, allocating its segment if no
+ * other thread has done so yet
+ *
+ * Parameters:
+ *   cs        The list's backend state
+ *   element   The element for the node
+ *
+ * Returns: The number of the node, which is not yet linked
+ */
+static uint32_t
+_CLC_new_ref(struct _cl_concurrent *cs, CListElementType element)
+{
+  uint32_t ref = _CLC_pop_ref(cs, &cs->free_head);
+
+  if (ref == CLC_NIL)
+  {
+    uint32_t index = atomic_fetch_add_explicit(&cs->carved, 1, memory_order_relaxed);
+    uint32_t offset;
+    int s = _CLC_segment(index, &offset);
+    assert(s < CLC_SEGMENTS);
+
+    if (atomic_load_explicit(&cs->segments[s], memory_order_acquire) == NULL)
+    {
+      struct _cl_cnode *segment = (struct _cl_cnode *)calloc(
+          (size_t)CLC_FIRST_SEGMENT << s, sizeof(struct _cl_cnode));
+      assert(segment);
+
+      struct _cl_cnode *expected = NULL;
+      if (!atomic_compare_exchange_strong_explicit(&cs->segments[s], &expected, segment,
+                                                   memory_order_acq_rel, memory_order_acquire))
+        free(segment); // another thread got there first
+    }
+
+    ref = index + 1;
+  }
+
+  atomic_store_explicit(&_CLC_node(cs, ref)->element, element, memory_order_relaxed);
+
+  return ref;
+}
+
+/*
+ * Append a node to a queue (Michael-Scott enqueue)
+ *
+ * Parameters:
+ *   cs     The list's backend state
+ *   ref    The number of the node to append
+ *
+ * Returns: None
+ */
+static void
+_CLC_enqueue_ref(struct _cl_concurrent *cs, uint32_t ref)
+{
+  _CLC_set_next(cs, ref, CLC_NIL);
+
+  uint64_t tail;
+  for (;;)
+  {
+    tail = atomic_load_explicit(&cs->tail, memory_order_acquire);
+    _Atomic uint64_t *link = &_CLC_node(cs, CLC_REF(tail))->next;
+    uint64_t next = atomic_load_explicit(link, memory_order_acquire);
+
+    if (tail != atomic_load_explicit(&cs->tail, memory_order_acquire))
+      continue;
+
+    if (CLC_REF(next) == CLC_NIL)
+    {
+      // link the node after the last one; the release ordering
+      // publishes its element to the thread that pops it
+      if (atomic_compare_exchange_weak_explicit(link, &next, CLC_TAGGED(next, ref),
+                                                memory_order_release, memory_order_relaxed))
+        break;
+    }
+    else
+    {
+      // another append linked a node but has not moved the tail yet;
+      // move it on that thread's behalf
+      atomic_compare_exchange_weak_explicit(&cs->tail, &tail, CLC_TAGGED(tail, CLC_REF(next)),
+                                            memory_order_release, memory_order_relaxed);
+    }
+  }
+
+  // if this fails, another thread has already moved the tail past us
+  atomic_compare_exchange_strong_explicit(&cs->tail, &tail, CLC_TAGGED(tail, ref),
+                                          memory_order_release, memory_order_relaxed);
+}
+
+/*
+ * Remove the first element of a queue (Michael-Scott dequeue)
+ *
+ * Parameters:
+ *   cs        The list's backend state
+ *   element   Set to the element removed
+ *
+ * Returns: The number of the node released by the removal, which was
+ *   the dummy before it, or CLC_NIL if the queue was empty
+ */
+static uint32_t
+_CLC_dequeue_ref(struct _cl_concurrent *cs, CListElementType *element)
+{
+  for (;;)
+  {
+    uint64_t head = atomic_load_explicit(&cs->head, memory_order_acquire);
+    uint64_t tail = atomic_load_explicit(&cs->tail, memory_order_acquire);
+    uint64_t next = _CLC_next_word(cs, CLC_REF(head));
+
+    if (head != atomic_load_explicit(&cs->head, memory_order_acquire))
+      continue;
+
+    if (CLC_REF(head) == CLC_REF(tail))
+    {
+      if (CLC_REF(next) == CLC_NIL)
+        return CLC_NIL;
+
+      // the tail is lagging behind an append; move it along
+      atomic_compare_exchange_weak_explicit(&cs->tail, &tail, CLC_TAGGED(tail, CLC_REF(next)),
+                                            memory_order_release, memory_order_relaxed);
+    }
+    else
+    {
+      // read the element before the exchange, after which the node may
+      // be released by another pop
+      *element = _CLC_element(cs, CLC_REF(next));
+      if (atomic_compare_exchange_weak_explicit(&cs->head, &head, CLC_TAGGED(head, CLC_REF(next)),
+                                                memory_order_acquire, memory_order_relaxed))
+        return CLC_REF(head);
+    }
+  }
+}
+
+/*
+ * Return the number of the node whose link leads to position 0 of a
+ * list: the dummy for a queue, or CLC_NIL for a stack, whose head is
+ * the link
+ */
+static inline uint32_t
+_CLC_front(struct _cl_concurrent *cs)
+{
+  return cs->fifo ? CLC_REF(atomic_load_explicit(&cs->head, memory_order_acquire)) : CLC_NIL;
+}
+
+/*
+ * Return the number of the node after a given one, where CLC_NIL
+ * stands for a stack's head
+ */
+static inline uint32_t
+_CLC_after(struct _cl_concurrent *cs, uint32_t ref)
+{
+  if (ref == CLC_NIL)
+    return CLC_REF(atomic_load_explicit(&cs->head, memory_order_acquire));
+
+  return _CLC_next(cs, ref);
+}
+
+/*
+ * Return the number of the node before a position of a quiescent
+ * list, in the range [0, length], which is the front for position 0
+ */
+static uint32_t
+_CLC_before(struct _cl_concurrent *cs, ptrdiff_t pos)
+{
+  uint32_t ref = _CLC_front(cs);
+
+  while (pos-- > 0)
+    ref = _CLC_after(cs, ref);
+
+  return ref;
+}
+
+/*
+ * Link a new element into a quiescent list after a given node
+ *
+ * Parameters:
+ *   list      The list
+ *   prev      The number of the node to link after, which may be the
+ *             front (see _CLC_front)
+ *   element   The element to link in
+ *
+ * Returns: The number of the new node
+ */
+static uint32_t
+_CLC_link_after(CList list, uint32_t prev, CListElementType element)
+{
+  struct _cl_concurrent *cs = CONCURRENT(list);
+  uint32_t ref = _CLC_new_ref(cs, element);
+
+  if (prev == CLC_NIL)
+    _CLC_push_ref(cs, &cs->head, ref);
+  else
+  {
+    uint32_t next = _CLC_next(cs, prev);
+    _CLC_set_next(cs, ref, next);
+    _CLC_set_next(cs, prev, ref);
+
+    if (cs->fifo && next == CLC_NIL)
+      atomic_store_explicit(&cs->tail, CLC_TAGGED(cs->tail, ref), memory_order_release);
+  }
+
+  list->length++;
+
+  return ref;
+}
+
+/*
+ * Unlink the node after a given one from a quiescent list, and
+ * release it
+ *
+ * Parameters:
+ *   list   The list
+ *   prev   The number of the node before the one to unlink, which may
+ *          be the front (see _CLC_front)
+ *
+ * Returns: The element of the unlinked node
+ */
+static CListElementType
+_CLC_unlink_after(CList list, uint32_t prev)
+{
+  struct _cl_concurrent *cs = CONCURRENT(list);
+  uint32_t ref;
+
+  if (prev == CLC_NIL)
+    ref = _CLC_pop_ref(cs, &cs->head);
+  else
+  {
+    ref = _CLC_next(cs, prev);
+    _CLC_set_next(cs, prev, _CLC_next(cs, ref));
+
+    if (cs->fifo && CLC_REF(cs->tail) == ref)
+      atomic_store_explicit(&cs->tail, CLC_TAGGED(cs->tail, prev), memory_order_release);
+  }
+
+  list->length--;
+
+  CListElementType element = _CLC_element(cs, ref);
+  _CLC_push_ref(cs, &cs->free_head, ref);
+
+  return element;
+}
+
+/*
+ * Return the number of the last node of a quiescent list, which is
+ * the front (see _CLC_front) if the list is empty
+ */
+static uint32_t
+_CLC_last(CList list)
+{
+  struct _cl_concurrent *cs = CONCURRENT(list);
+
+  if (cs->fifo)
+    return CLC_REF(atomic_load_explicit(&cs->tail, memory_order_acquire));
+
+  return _CLC_before(cs, list->length);
+}
+
+/*
+ * The operations below implement struct _cl_ops for concurrent
+ * lists; see clist_internal.h. Only the stack's push and pop, and the
+ * queue's append and pop, may run concurrently.
+ */
+
+static void
+_CLC_free(CList list)
+{
+  struct _cl_concurrent *cs = CONCURRENT(list);
+
+  for (int s = 0; s < CLC_SEGMENTS; s++)
+    free(atomic_load_explicit(&cs->segments[s], memory_order_relaxed));
+
+  free(cs);
+}
+
+static bool
+_CLC_check(CList list)
+{
+  struct _cl_concurrent *cs = CONCURRENT(list);
+  uint32_t carved = atomic_load_explicit(&cs->carved, memory_order_relaxed);
+
+  // a queue's dummy is in use too. No more nodes than were ever carved
+  // can be reached, unless the links form a cycle.
+  uint32_t in_use = cs->fifo ? 1 : 0;
+  uint32_t last = _CLC_front(cs);
+  for (uint32_t ref = _CLC_after(cs, last); ref != CLC_NIL; ref = _CLC_next(cs, ref))
+  {
+    last = ref;
+    if (++in_use > carved)
+      return false;
+  }
+  if (in_use != (uint32_t)list->length + (cs->fifo ? 1 : 0) || (cs->fifo && last != CLC_REF(cs->tail)))
+    return false;
+
+  uint32_t released = 0;
+  for (uint32_t ref = CLC_REF(cs->free_head); ref != CLC_NIL; ref = _CLC_next(cs, ref))
+    if (in_use + ++released > carved)
+      return false;
+
+  return in_use + released == carved;
+}
+
+static void
+_CLC_push(CList list, CListElementType element)
+{
+  struct _cl_concurrent *cs = CONCURRENT(list);
+
+  // the length is counted before the node is published: the release
+  // in publishing it orders the increment before the decrement of any
+  // pop that takes the node, so the length never drops below zero
+  __atomic_fetch_add(&list->length, 1, __ATOMIC_RELAXED);
+  _CLC_push_ref(cs, &cs->head, _CLC_new_ref(cs, element));
+}
+
+static CListElementType
+_CLC_pop(CList list)
+{
+  struct _cl_concurrent *cs = CONCURRENT(list);
+
+  // another thread may have emptied the list since the caller looked
+  uint32_t ref = _CLC_pop_ref(cs, &cs->head);
+  if (ref == CLC_NIL)
+    return INVALID_RETURN;
+
+  __atomic_fetch_sub(&list->length, 1, __ATOMIC_RELAXED);
+
+  // the node is ours until it goes onto the free list
+  CListElementType element = _CLC_element(cs, ref);
+  _CLC_push_ref(cs, &cs->free_head, ref);
+
+  return element;
+}
+
+static bool
+_CLC_insert(CList list, CListElementType element, ptrdiff_t pos)
+{
+  _CLC_link_after(list, _CLC_before(CONCURRENT(list), pos), element);
+  return true;
+}
+
+static void
+_CLC_append(CList list, CListElementType element)
+{
+  _CLC_link_after(list, _CLC_last(list), element);
+}
+
+static CListElementType
+_CLC_nth(CList list, ptrdiff_t pos)
+{
+  struct _cl_concurrent *cs = CONCURRENT(list);
+  return _CLC_element(cs, _CLC_after(cs, _CLC_before(cs, pos)));
+}
+
+static CListElementType
+_CLC_remove(CList list, ptrdiff_t pos)
+{
+  return _CLC_unlink_after(list, _CLC_before(CONCURRENT(list), pos));
+}
+
+static CList
+_CLC_copy(CList list)
+{
+  struct _cl_concurrent *cs = CONCURRENT(list);
+  CList list_copy = cs->fifo ? CL_new_concurrent_queue() : CL_new_concurrent();
+
+  uint32_t last = _CLC_front(CONCURRENT(list_copy));
+  for (uint32_t ref = _CLC_after(cs, _CLC_front(cs)); ref != CLC_NIL; ref = _CLC_next(cs, ref))
+    last = _CLC_link_after(list_copy, last, _CLC_element(cs, ref));
+
+  return list_copy;
+}
+
+static ptrdiff_t
+_CLC_insert_sorted(CList list, CListElementType element)
+{
+  struct _cl_concurrent *cs = CONCURRENT(list);
+
+  // find the last node whose element sorts before the new one
+  uint32_t prev = _CLC_front(cs);
+  ptrdiff_t position = 0;
+  for (uint32_t ref = _CLC_after(cs, prev); ref != CLC_NIL; ref = _CLC_next(cs, ref))
+  {
+    if (strcmp(_CLC_element(cs, ref), element) >= 0)
+      break;
+    prev = ref;
+    position++;
+  }
+
+  _CLC_link_after(list, prev, element);
+
+  return position;
+}
+
+static void
+_CLC_join(CList list1, CList list2)
+{
+  // node numbers belong to one list, so the elements of list2 are moved
+  // into new nodes after the last node of list1
+  uint32_t last = _CLC_last(list1);
+  uint32_t front2 = _CLC_front(CONCURRENT(list2));
+
+  while (list2->length > 0)
+    last = _CLC_link_after(list1, last, _CLC_unlink_after(list2, front2));
+}
+
+static void
+_CLC_reverse(CList list)
+{
+  struct _cl_concurrent *cs = CONCURRENT(list);
+  uint32_t front = _CLC_front(cs);
+  uint32_t first = _CLC_after(cs, front);
+
+  uint32_t prev = CLC_NIL;
+  uint32_t ref = first;
+  while (ref != CLC_NIL)
+  {
+    uint32_t next = _CLC_next(cs, ref);
+    _CLC_set_next(cs, ref, prev);
+    prev = ref;
+    ref = next;
+  }
+
+  // the old first node is now the last
+  if (cs->fifo)
+  {
+    _CLC_set_next(cs, front, prev);
+    if (first != CLC_NIL)
+      atomic_store_explicit(&cs->tail, CLC_TAGGED(cs->tail, first), memory_order_release);
+  }
+  else
+    atomic_store_explicit(&cs->head, CLC_TAGGED(cs->head, prev), memory_order_release);
+}
+
+static void
+_CLC_foreach(CList list, CL_foreach64_callback callback, void *cb_data)
+{
+  struct _cl_concurrent *cs = CONCURRENT(list);
+
+  size_t position = 0;
+  for (uint32_t ref = _CLC_after(cs, _CLC_front(cs)); ref != CLC_NIL; ref = _CLC_next(cs, ref))
+    callback(position++, _CLC_element(cs, ref), cb_data);
+}
+
+static CListElementType
+_CLC_dequeue(CList list)
+{
+  struct _cl_concurrent *cs = CONCURRENT(list);
+
+  CListElementType element;
+  uint32_t ref = _CLC_dequeue_ref(cs, &element);
+  if (ref == CLC_NIL)
+    return INVALID_RETURN;
+
+  __atomic_fetch_sub(&list->length, 1, __ATOMIC_RELAXED);
+  _CLC_push_ref(cs, &cs->free_head, ref);
+
+  return element;
+}
+
+static void
+_CLC_enqueue(CList list, CListElementType element)
+{
+  struct _cl_concurrent *cs = CONCURRENT(list);
+
+  // counted before the node is published, as in _CLC_push
+  __atomic_fetch_add(&list->length, 1, __ATOMIC_RELAXED);
+  _CLC_enqueue_ref(cs, _CLC_new_ref(cs, element));
+}
+
+static void
+_CLC_push_front(CList list, CListElementType element)
+{
+  _CLC_insert(list, element, 0);
+}
+
+const struct _cl_ops _CL_concurrent_ops = {
+    .free = _CLC_free,
+    .check = _CLC_check,
+    .push = _CLC_push,
+    .pop = _CLC_pop,
+    .append = _CLC_append,
+    .nth = _CLC_nth,
+    .insert = _CLC_insert,
+    .remove = _CLC_remove,
+    .copy = _CLC_copy,
+    .insert_sorted = _CLC_insert_sorted,
+    .join = _CLC_join,
+    .reverse = _CLC_reverse,
+    .foreach = _CLC_foreach,
+    .concurrent = true,
+};
+
+// the queue shares every quiescent operation with the stack
+const struct _cl_ops _CL_concurrent_queue_ops = {
+    .free = _CLC_free,
+    .check = _CLC_check,
+    .push = _CLC_push_front,
+    .pop = _CLC_dequeue,
+    .append = _CLC_enqueue,
+    .nth = _CLC_nth,
+    .insert = _CLC_insert,
+    .remove = _CLC_remove,
+    .copy = _CLC_copy,
+    .insert_sorted = _CLC_insert_sorted,
+    .join = _CLC_join,
+    .reverse = _CLC_reverse,
+    .foreach = _CLC_foreach,
+    .concurrent = true,
+};
+
+/*
+ * Create a list using one of the concurrent backends
+ *
+ * Parameters:
+ *   fifo   true for a queue, false for a stack
+ *
+ * Returns: The new list
+ */
+static CList
+_CLC_new(bool fifo)
+{
+  CList list = CL_new();
+
+  struct _cl_concurrent *cs = (struct _cl_concurrent *)aligned_alloc(
+      CLC_CACHE_LINE, sizeof(struct _cl_concurrent));
+  assert(cs);
+
+  atomic_init(&cs->head, CLC_NIL);
+  atomic_init(&cs->tail, CLC_NIL);
+  atomic_init(&cs->free_head, CLC_NIL);
+  atomic_init(&cs->carved, 0);
+  cs->fifo = fifo;
+  for (int s = 0; s < CLC_SEGMENTS; s++)
+    atomic_init(&cs->segments[s], NULL);
+
+  // a queue always holds a dummy node, which the head and tail start on
+  if (fifo)
+  {
+    uint32_t dummy = _CLC_new_ref(cs, NULL);
+    atomic_store(&cs->head, CLC_TAGGED(0, dummy));
+    atomic_store(&cs->tail, CLC_TAGGED(0, dummy));
+  }
+
+  list->ops = fifo ? &_CL_concurrent_queue_ops : &_CL_concurrent_ops;
+  list->impl = cs;
+
+  return list;
+}
+
+// Documented in .h file
+CList CL_new_concurrent()
+{
+  return _CLC_new(false);
+}
+
+// Documented in .h file
+CList CL_new_concurrent_queue()
+{
+  return _CLC_new(true);
+}
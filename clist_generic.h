@@ -0,0 +1,370 @@
+/*
+ * clist_generic.h
+ *
+ * Type-generic linked lists, specialized at compile time.
+ *
+ * CList stores CListElementType values, which are pointers to data
+ * kept outside the list. The macros in this file instead generate a
+ * complete list type for any element type, stored by value in the
+ * node, with the comparison used by the sorted operations expanded
+ * inline:
+ *
+ *   // in a header
+ *   CLIST_DECLARE(I64List, int64_t)
+ *
+ *   // in exactly one .c file
+ *   CLIST_DEFINE(I64List, int64_t, CLIST_CMP_SCALAR)
+ *
+ * This generates the type I64List and the functions I64List_new,
+ * I64List_free, I64List_length, I64List_push, I64List_pop,
+ * I64List_append, I64List_nth, I64List_insert, I64List_remove,
+ * I64List_copy, I64List_insert_sorted, I64List_sort, I64List_join,
+ * I64List_reverse and I64List_foreach.
+ *
+ * These behave like the CList functions of the same names, including
+ * the meaning of negative positions, with one difference: as a value
+ * type has no INVALID_RETURN, the functions that return an element
+ * (pop, nth and remove) instead store it through an out pointer, which
+ * may be NULL, and return true on success or false if there was no
+ * such element. Lengths and positions are 64-bit, as in CL_length64,
+ * CL_nth64 and the other 64-bit CList functions: lengths, the position
+ * insert_sorted returns and the position passed to a foreach callback
+ * are size_t, and positions that may be negative are ptrdiff_t.
+ *
+ * cmp must be usable as cmp(a, b) on two elements, returning a
+ * negative value, zero or a positive value as a sorts before, equal to
+ * or after b; it may be a function or a function-like macro. For
+ * example, a list equivalent to CList is generated by
+ *
+ *   CLIST_DEFINE(StrList, const char *, strcmp)
+ *
+ */
+
+#ifndef _CLIST_GENERIC_H_
+#define _CLIST_GENERIC_H_
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <assert.h>
+
+// Comparison for arithmetic element types
+#define CLIST_CMP_SCALAR(a, b) (((a) > (b)) - ((a) < (b)))
+
+/*
+ * Declare the list type name holding elements of type type, and its
+ * functions
+ */
+#define CLIST_DECLARE(name, type)                                                   \
+  typedef struct name##_s *name;                                                    \
+  typedef void (*name##_foreach_callback)(size_t pos, type element, void *cb_data); \
+                                                                                    \
+  name name##_new();                                                                \
+  void name##_free(name list);                                                      \
+  size_t name##_length(name list);                                                  \
+  void name##_push(name list, type element);                                        \
+  bool name##_pop(name list, type *out);                                            \
+  void name##_append(name list, type element);                                      \
+  bool name##_nth(name list, ptrdiff_t pos, type *out);                             \
+  bool name##_insert(name list, type element, ptrdiff_t pos);                       \
+  bool name##_remove(name list, ptrdiff_t pos, type *out);                          \
+  name name##_copy(name list);                                                      \
+  size_t name##_insert_sorted(name list, type element);                             \
+  void name##_sort(name list);                                                      \
+  void name##_join(name list1, name list2);                                         \
+  void name##_reverse(name list);                                                   \
+  void name##_foreach(name list, name##_foreach_callback callback, void *cb_data);
+
+/*
+ * Define the list type name holding elements of type type, ordered by
+ * cmp, and its functions. The declarations from CLIST_DECLARE are
+ * included, so CLIST_DEFINE may also be used on its own.
+ */
+#define CLIST_DEFINE(name, type, cmp)                                              \
+  CLIST_DECLARE(name, type)                                                        \
+                                                                                   \
+  struct name##_node                                                               \
+  {                                                                                \
+    type element;                                                                  \
+    struct name##_node *next;                                                      \
+  };                                                                               \
+                                                                                   \
+  struct name##_s                                                                  \
+  {                                                                                \
+    struct name##_node *head;                                                      \
+    struct name##_node *tail;                                                      \
+    ptrdiff_t length;                                                              \
+  };                                                                               \
+                                                                                   \
+  /* Create (malloc) a new node holding element */                                 \
+  static struct name##_node *                                                      \
+  name##_new_node(type element, struct name##_node *next)                          \
+  {                                                                                \
+    struct name##_node *new = (struct name##_node *)malloc(sizeof(*new));          \
+    assert(new);                                                                   \
+    new->element = element;                                                        \
+    new->next = next;                                                              \
+    return new;                                                                    \
+  }                                                                                \
+                                                                                   \
+  /* Return the node before position pos, in the range [1, length] */              \
+  static struct name##_node *                                                      \
+  name##_node_before(name list, ptrdiff_t pos)                                     \
+  {                                                                                \
+    if (pos == list->length)                                                       \
+      return list->tail;                                                           \
+    struct name##_node *node = list->head;                                         \
+    while (--pos > 0)                                                              \
+      node = node->next;                                                           \
+    return node;                                                                   \
+  }                                                                                \
+                                                                                   \
+  name name##_new()                                                                \
+  {                                                                                \
+    name list = (name)malloc(sizeof(struct name##_s));                             \
+    assert(list);                                                                  \
+    list->head = NULL;                                                             \
+    list->tail = NULL;                                                             \
+    list->length = 0;                                                              \
+    return list;                                                                   \
+  }                                                                                \
+                                                                                   \
+  void name##_free(name list)                                                      \
+  {                                                                                \
+    assert(list);                                                                  \
+    struct name##_node *node = list->head;                                         \
+    while (node != NULL)                                                           \
+    {                                                                              \
+      struct name##_node *next_node = node->next;                                  \
+      free(node);                                                                  \
+      node = next_node;                                                            \
+    }                                                                              \
+    free(list);                                                                    \
+  }                                                                                \
+                                                                                   \
+  size_t name##_length(name list)                                                  \
+  {                                                                                \
+    assert(list);                                                                  \
+    return (size_t)list->length;                                                   \
+  }                                                                                \
+                                                                                   \
+  void name##_push(name list, type element)                                        \
+  {                                                                                \
+    assert(list);                                                                  \
+    list->head = name##_new_node(element, list->head);                             \
+    if (list->tail == NULL)                                                        \
+      list->tail = list->head;                                                     \
+    list->length++;                                                                \
+  }                                                                                \
+                                                                                   \
+  bool name##_pop(name list, type *out)                                            \
+  {                                                                                \
+    return name##_remove(list, 0, out);                                            \
+  }                                                                                \
+                                                                                   \
+  void name##_append(name list, type element)                                      \
+  {                                                                                \
+    assert(list);                                                                  \
+    struct name##_node *new_node = name##_new_node(element, NULL);                 \
+    if (list->tail == NULL)                                                        \
+      list->head = new_node;                                                       \
+    else                                                                           \
+      list->tail->next = new_node;                                                 \
+    list->tail = new_node;                                                         \
+    list->length++;                                                                \
+  }                                                                                \
+                                                                                   \
+  bool name##_nth(name list, ptrdiff_t pos, type *out)                             \
+  {                                                                                \
+    assert(list);                                                                  \
+    if (pos < 0)                                                                   \
+      pos = list->length + pos;                                                    \
+    if (pos < 0 || pos >= list->length)                                            \
+      return false;                                                                \
+    struct name##_node *node =                                                     \
+        (pos == 0) ? list->head : name##_node_before(list, pos)->next;             \
+    if (out != NULL)                                                               \
+      *out = node->element;                                                        \
+    return true;                                                                   \
+  }                                                                                \
+                                                                                   \
+  bool name##_insert(name list, type element, ptrdiff_t pos)                       \
+  {                                                                                \
+    assert(list);                                                                  \
+    if (pos < 0)                                                                   \
+      pos = list->length + pos + 1;                                                \
+    if (pos < 0 || pos > list->length)                                             \
+      return false;                                                                \
+    if (pos == 0)                                                                  \
+      name##_push(list, element);                                                  \
+    else if (pos == list->length)                                                  \
+      name##_append(list, element);                                                \
+    else                                                                           \
+    {                                                                              \
+      struct name##_node *prev = name##_node_before(list, pos);                    \
+      prev->next = name##_new_node(element, prev->next);                           \
+      list->length++;                                                              \
+    }                                                                              \
+    return true;                                                                   \
+  }                                                                                \
+                                                                                   \
+  bool name##_remove(name list, ptrdiff_t pos, type *out)                          \
+  {                                                                                \
+    assert(list);                                                                  \
+    if (pos < 0)                                                                   \
+      pos = list->length + pos;                                                    \
+    if (pos < 0 || pos >= list->length)                                            \
+      return false;                                                                \
+    struct name##_node *prev = (pos == 0) ? NULL : name##_node_before(list, pos);  \
+    struct name##_node *rm_node = (prev == NULL) ? list->head : prev->next;        \
+    if (prev == NULL)                                                              \
+      list->head = rm_node->next;                                                  \
+    else                                                                           \
+      prev->next = rm_node->next;                                                  \
+    if (rm_node == list->tail)                                                     \
+      list->tail = prev;                                                           \
+    list->length--;                                                                \
+    if (out != NULL)                                                               \
+      *out = rm_node->element;                                                     \
+    free(rm_node);                                                                 \
+    return true;                                                                   \
+  }                                                                                \
+                                                                                   \
+  name name##_copy(name list)                                                      \
+  {                                                                                \
+    assert(list);                                                                  \
+    name list_copy = name##_new();                                                 \
+    for (struct name##_node *node = list->head; node != NULL; node = node->next)   \
+      name##_append(list_copy, node->element);                                     \
+    return list_copy;                                                              \
+  }                                                                                \
+                                                                                   \
+  size_t name##_insert_sorted(name list, type element)                             \
+  {                                                                                \
+    assert(list);                                                                  \
+    if (list->tail == NULL || cmp(list->tail->element, element) < 0)               \
+    {                                                                              \
+      name##_append(list, element);                                                \
+      return (size_t)list->length - 1;                                             \
+    }                                                                              \
+    struct name##_node *prev = NULL;                                               \
+    struct name##_node *node = list->head;                                         \
+    size_t position = 0;                                                           \
+    while (cmp(node->element, element) < 0)                                        \
+    {                                                                              \
+      prev = node;                                                                 \
+      node = node->next;                                                           \
+      position++;                                                                  \
+    }                                                                              \
+    if (prev == NULL)                                                              \
+      name##_push(list, element);                                                  \
+    else                                                                           \
+    {                                                                              \
+      prev->next = name##_new_node(element, node);                                 \
+      list->length++;                                                              \
+    }                                                                              \
+    return position;                                                               \
+  }                                                                                \
+                                                                                   \
+  /* Stable merge of two sorted chains; see _CL_merge_chains in clist.c */         \
+  static struct name##_node *                                                      \
+  name##_merge_chains(struct name##_node *a, struct name##_node *b)                \
+  {                                                                                \
+    struct name##_node head;                                                       \
+    struct name##_node *last = &head;                                              \
+    while (a != NULL && b != NULL)                                                 \
+    {                                                                              \
+      if (cmp(b->element, a->element) < 0)                                         \
+      {                                                                            \
+        last->next = b;                                                            \
+        b = b->next;                                                               \
+      }                                                                            \
+      else                                                                         \
+      {                                                                            \
+        last->next = a;                                                            \
+        a = a->next;                                                               \
+      }                                                                            \
+      last = last->next;                                                           \
+    }                                                                              \
+    last->next = (a != NULL) ? a : b;                                              \
+    return head.next;                                                              \
+  }                                                                                \
+                                                                                   \
+  void name##_sort(name list)                                                      \
+  {                                                                                \
+    assert(list);                                                                  \
+    struct name##_node *bins[8 * sizeof(size_t) + 1] = {NULL};                     \
+    int max_bin = 0;                                                               \
+    struct name##_node *node = list->head;                                         \
+    while (node != NULL)                                                           \
+    {                                                                              \
+      struct name##_node *carry = node;                                            \
+      node = node->next;                                                           \
+      carry->next = NULL;                                                          \
+      int i;                                                                       \
+      for (i = 0; bins[i] != NULL; i++)                                            \
+      {                                                                            \
+        carry = name##_merge_chains(bins[i], carry);                               \
+        bins[i] = NULL;                                                            \
+      }                                                                            \
+      bins[i] = carry;                                                             \
+      if (i > max_bin)                                                             \
+        max_bin = i;                                                               \
+    }                                                                              \
+    struct name##_node *sorted = NULL;                                             \
+    for (int i = 0; i <= max_bin; i++)                                             \
+      if (bins[i] != NULL)                                                         \
+        sorted = name##_merge_chains(bins[i], sorted);                             \
+    list->head = sorted;                                                           \
+    list->tail = NULL;                                                             \
+    for (node = sorted; node != NULL; node = node->next)                           \
+      list->tail = node;                                                           \
+  }                                                                                \
+                                                                                   \
+  void name##_join(name list1, name list2)                                         \
+  {                                                                                \
+    assert(list1);                                                                 \
+    assert(list2);                                                                 \
+    if (list2->head == NULL)                                                       \
+      return;                                                                      \
+    if (list1->head == NULL)                                                       \
+      list1->head = list2->head;                                                   \
+    else                                                                           \
+      list1->tail->next = list2->head;                                             \
+    list1->tail = list2->tail;                                                     \
+    list1->length += list2->length;                                                \
+    list2->head = NULL;                                                            \
+    list2->tail = NULL;                                                            \
+    list2->length = 0;                                                             \
+  }                                                                                \
+                                                                                   \
+  void name##_reverse(name list)                                                   \
+  {                                                                                \
+    assert(list);                                                                  \
+    struct name##_node *prev = NULL;                                               \
+    struct name##_node *node = list->head;                                         \
+    list->tail = node;                                                             \
+    while (node != NULL)                                                           \
+    {                                                                              \
+      struct name##_node *next_node = node->next;                                  \
+      node->next = prev;                                                           \
+      prev = node;                                                                 \
+      node = next_node;                                                            \
+    }                                                                              \
+    list->head = prev;                                                             \
+  }                                                                                \
+                                                                                   \
+  void name##_foreach(name list, name##_foreach_callback callback, void *cb_data)  \
+  {                                                                                \
+    assert(list);                                                                  \
+    if (callback == NULL)                                                          \
+      return;                                                                      \
+    size_t position = 0;                                                           \
+    for (struct name##_node *node = list->head; node != NULL; node = node->next)   \
+      callback(position++, node->element, cb_data);                                \
+  }
+
+
+#endif /* _CLIST_GENERIC_H_ */
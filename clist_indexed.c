@@ -0,0 +1,455 @@
+/*
+ * clist_indexed.c
+ *
+ * Indexed backend for CList. Elements are kept in an implicit treap:
+ * a randomized balanced binary tree ordered by position, in which each
+ * node records the size of its subtree. A position is found by
+ * comparing it with subtree sizes on the way down, so CL_nth,
+ * CL_insert and CL_remove take O(log n) expected time. CL_join and
+ * CL_reverse take O(log n) and O(1) time respectively.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+
+#include "clist.h"
+#include "clist_internal.h"
+
+struct _cl_tnode
+{
+  CListElementType element;
+  struct _cl_tnode *left;
+  struct _cl_tnode *right;
+  // the size, priority and flag share one word, so that a node is four
+  // words long; subtrees of up to 2^40 nodes fit
+  uint64_t size : 40;     // number of nodes in this subtree
+  uint64_t priority : 23; // heap order: no child has a higher priority
+  uint64_t reversed : 1;  // the children of this subtree are yet to be swapped
+};
+
+struct _cl_indexed
+{
+  struct _cl_tnode *root;
+  uint32_t seed; // state of the random priority generator
+};
+
+#define INDEXED(list) ((struct _cl_indexed *)(list)->impl)
+
+/*
+ * Return the size of a subtree, which may be empty
+ */
+static inline ptrdiff_t
+_CLI_size(struct _cl_tnode *t)
+{
+  return (t == NULL) ? 0 : (ptrdiff_t)t->size;
+}
+
+/*
+ * Recompute the size of a node from its children
+ */
+static inline void
+_CLI_update(struct _cl_tnode *t)
+{
+  t->size = 1 + _CLI_size(t->left) + _CLI_size(t->right);
+}
+
+/*
+ * Apply a pending reversal of node t to its children, so that its
+ * left and right links can be followed in position order
+ */
+static inline void
+_CLI_push_down(struct _cl_tnode *t)
+{
+  if (t->reversed)
+  {
+    struct _cl_tnode *tmp = t->left;
+    t->left = t->right;
+    t->right = tmp;
+
+    if (t->left != NULL)
+      t->left->reversed ^= 1;
+    if (t->right != NULL)
+      t->right->reversed ^= 1;
+
+    t->reversed = 0;
+  }
+}
+
+/*
+ * Create (malloc) a single-node tree holding element, with a fresh
+ * random priority drawn from the list's generator (xorshift32)
+ *
+ * Parameters:
+ *   ix       The list's backend state
+ *   element  The element for the new node
+ *
+ * Returns: The new node
+ */
+static struct _cl_tnode *
+_CLI_new_node(struct _cl_indexed *ix, CListElementType element)
+{
+  struct _cl_tnode *t = (struct _cl_tnode *)malloc(sizeof(struct _cl_tnode));
+  assert(t);
+
+  ix->seed ^= ix->seed << 13;
+  ix->seed ^= ix->seed >> 17;
+  ix->seed ^= ix->seed << 5;
+
+  t->element = element;
+  t->left = NULL;
+  t->right = NULL;
+  t->size = 1;
+  t->priority = ix->seed >> 9;
+  t->reversed = 0;
+
+  return t;
+}
+
+/*
+ * Split a tree into the nodes at positions [0, pos) and the rest
+ *
+ * Parameters:
+ *   t        The tree
+ *   pos      Number of nodes to put in the left part
+ *   left     Set to the tree of the first pos nodes
+ *   right    Set to the tree of the remaining nodes
+ *
+ * Returns: None
+ */
+static void
+_CLI_split(struct _cl_tnode *t, ptrdiff_t pos, struct _cl_tnode **left, struct _cl_tnode **right)
+{
+  if (t == NULL)
+  {
+    *left = NULL;
+    *right = NULL;
+    return;
+  }
+
+  _CLI_push_down(t);
+
+  if (_CLI_size(t->left) < pos)
+  {
+    _CLI_split(t->right, pos - _CLI_size(t->left) - 1, &t->right, right);
+    *left = t;
+  }
+  else
+  {
+    _CLI_split(t->left, pos, left, &t->left);
+    *right = t;
+  }
+
+  _CLI_update(t);
+}
+
+/*
+ * Concatenate two trees
+ *
+ * Parameters:
+ *   left, right   The trees; every node of left comes before every
+ *                 node of right
+ *
+ * Returns: The combined tree
+ */
+static struct _cl_tnode *
+_CLI_merge(struct _cl_tnode *left, struct _cl_tnode *right)
+{
+  if (left == NULL)
+    return right;
+  if (right == NULL)
+    return left;
+
+  if (left->priority > right->priority)
+  {
+    _CLI_push_down(left);
+    left->right = _CLI_merge(left->right, right);
+    _CLI_update(left);
+    return left;
+  }
+  else
+  {
+    _CLI_push_down(right);
+    right->left = _CLI_merge(left, right->left);
+    _CLI_update(right);
+    return right;
+  }
+}
+
+/*
+ * Deallocate every node of a tree
+ */
+static void
+_CLI_free_tree(struct _cl_tnode *t)
+{
+  if (t == NULL)
+    return;
+
+  _CLI_free_tree(t->left);
+  _CLI_free_tree(t->right);
+  free(t);
+}
+
+/*
+ * Make a structural copy of a tree, preserving priorities and pending
+ * reversals
+ */
+static struct _cl_tnode *
+_CLI_copy_tree(struct _cl_tnode *t)
+{
+  if (t == NULL)
+    return NULL;
+
+  struct _cl_tnode *copy = (struct _cl_tnode *)malloc(sizeof(struct _cl_tnode));
+  assert(copy);
+
+  *copy = *t;
+  copy->left = _CLI_copy_tree(t->left);
+  copy->right = _CLI_copy_tree(t->right);
+
+  return copy;
+}
+
+/*
+ * Check the size and heap invariants of a tree
+ *
+ * Parameters:
+ *   t        The tree
+ *   budget   The number of nodes the tree may have at most; reduced by
+ *            the number found, so that a cycle ends the check
+ *
+ * Returns: The number of nodes in the tree, or -1 if an invariant does
+ *   not hold
+ */
+static ptrdiff_t
+_CLI_check_tree(struct _cl_tnode *t, ptrdiff_t *budget)
+{
+  if (t == NULL)
+    return 0;
+
+  if (--*budget < 0)
+    return -1;
+
+  if ((t->left != NULL && t->left->priority > t->priority) ||
+      (t->right != NULL && t->right->priority > t->priority))
+    return -1;
+
+  ptrdiff_t left = _CLI_check_tree(t->left, budget);
+  ptrdiff_t right = (left < 0) ? -1 : _CLI_check_tree(t->right, budget);
+  if (right < 0 || 1 + left + right != _CLI_size(t))
+    return -1;
+
+  return _CLI_size(t);
+}
+
+/*
+ * Call callback for every node of a tree in position order
+ *
+ * Parameters:
+ *   t          The tree
+ *   position   Position of the first node of the tree
+ *   callback   The function to call
+ *   cb_data    Caller data to pass to the function
+ *
+ * Returns: None
+ */
+static void
+_CLI_foreach_tree(struct _cl_tnode *t, size_t position, CL_foreach64_callback callback, void *cb_data)
+{
+  // loop down the right spine so that only left subtrees recurse
+  while (t != NULL)
+  {
+    _CLI_push_down(t);
+    _CLI_foreach_tree(t->left, position, callback, cb_data);
+    position += _CLI_size(t->left);
+    callback(position++, t->element, cb_data);
+    t = t->right;
+  }
+}
+
+/*
+ * The operations below implement struct _cl_ops for indexed lists;
+ * see clist_internal.h
+ */
+
+static void
+_CLI_free(CList list)
+{
+  _CLI_free_tree(INDEXED(list)->root);
+  free(list->impl);
+}
+
+static bool
+_CLI_check(CList list)
+{
+  ptrdiff_t budget = list->length;
+  return _CLI_check_tree(INDEXED(list)->root, &budget) == list->length;
+}
+
+static bool
+_CLI_insert(CList list, CListElementType element, ptrdiff_t pos)
+{
+  struct _cl_indexed *ix = INDEXED(list);
+  struct _cl_tnode *left, *right;
+
+  _CLI_split(ix->root, pos, &left, &right);
+  ix->root = _CLI_merge(_CLI_merge(left, _CLI_new_node(ix, element)), right);
+  list->length++;
+
+  return true;
+}
+
+static CListElementType
+_CLI_remove(CList list, ptrdiff_t pos)
+{
+  struct _cl_indexed *ix = INDEXED(list);
+  struct _cl_tnode *left, *middle, *right;
+
+  _CLI_split(ix->root, pos, &left, &right);
+  _CLI_split(right, 1, &middle, &right);
+  ix->root = _CLI_merge(left, right);
+  list->length--;
+
+  CListElementType element = middle->element;
+  free(middle);
+
+  return element;
+}
+
+static void
+_CLI_push(CList list, CListElementType element)
+{
+  _CLI_insert(list, element, 0);
+}
+
+static CListElementType
+_CLI_pop(CList list)
+{
+  return _CLI_remove(list, 0);
+}
+
+static void
+_CLI_append(CList list, CListElementType element)
+{
+  _CLI_insert(list, element, list->length);
+}
+
+static CListElementType
+_CLI_nth(CList list, ptrdiff_t pos)
+{
+  struct _cl_tnode *t = INDEXED(list)->root;
+
+  for (;;)
+  {
+    _CLI_push_down(t);
+
+    ptrdiff_t left_size = _CLI_size(t->left);
+    if (pos < left_size)
+      t = t->left;
+    else if (pos == left_size)
+      return t->element;
+    else
+    {
+      pos -= left_size + 1;
+      t = t->right;
+    }
+  }
+}
+
+static CList
+_CLI_copy(CList list)
+{
+  CList list_copy = CL_new_indexed();
+
+  INDEXED(list_copy)->root = _CLI_copy_tree(INDEXED(list)->root);
+  list_copy->length = list->length;
+
+  return list_copy;
+}
+
+static ptrdiff_t
+_CLI_insert_sorted(CList list, CListElementType element)
+{
+  // find the position of the first element that is greater than or
+  // equal to the element we are inserting, by binary search down the
+  // tree
+  ptrdiff_t position = 0;
+  struct _cl_tnode *t = INDEXED(list)->root;
+  while (t != NULL)
+  {
+    _CLI_push_down(t);
+
+    if (strcmp(t->element, element) < 0)
+    {
+      position += _CLI_size(t->left) + 1;
+      t = t->right;
+    }
+    else
+      t = t->left;
+  }
+
+  _CLI_insert(list, element, position);
+
+  return position;
+}
+
+static void
+_CLI_join(CList list1, CList list2)
+{
+  INDEXED(list1)->root = _CLI_merge(INDEXED(list1)->root, INDEXED(list2)->root);
+  list1->length += list2->length;
+
+  INDEXED(list2)->root = NULL;
+  list2->length = 0;
+}
+
+static void
+_CLI_reverse(CList list)
+{
+  struct _cl_tnode *root = INDEXED(list)->root;
+
+  if (root != NULL)
+    root->reversed ^= 1;
+}
+
+static void
+_CLI_foreach(CList list, CL_foreach64_callback callback, void *cb_data)
+{
+  _CLI_foreach_tree(INDEXED(list)->root, 0, callback, cb_data);
+}
+
+const struct _cl_ops _CL_indexed_ops = {
+    .free = _CLI_free,
+    .check = _CLI_check,
+    .push = _CLI_push,
+    .pop = _CLI_pop,
+    .append = _CLI_append,
+    .nth = _CLI_nth,
+    .insert = _CLI_insert,
+    .remove = _CLI_remove,
+    .copy = _CLI_copy,
+    .insert_sorted = _CLI_insert_sorted,
+    .join = _CLI_join,
+    .reverse = _CLI_reverse,
+    .foreach = _CLI_foreach,
+};
+
+// Documented in .h file
+CList CL_new_indexed()
+{
+  CList list = CL_new();
+
+  struct _cl_indexed *ix = (struct _cl_indexed *)malloc(sizeof(struct _cl_indexed));
+  assert(ix);
+
+  ix->root = NULL;
+  ix->seed = 2463534242u;
+
+  list->ops = &_CL_indexed_ops;
+  list->impl = ix;
+
+  return list;
+}
@@ -0,0 +1,183 @@
+/*
+ * clist_internal.h
+ *
+ * Definitions shared between clist.c and the alternative list
+ * backends. Nothing in this file is part of the public API.
+ *
+ */
+
+#ifndef _CLIST_INTERNAL_H_
+#define _CLIST_INTERNAL_H_
+
+
+#include <stdint.h>
+
+#include "clist.h"
+
+// Checking tiers, chosen by building with -DCL_CHECK_LEVEL=n:
+//   0  no checks: assertions are compiled out, as with NDEBUG
+//   1  cheap assertions on arguments and constant-time invariants (the
+//      default)
+//   2  as well, every CL_length call validates the whole list with
+//      CL_validate, which makes CL_length O(n)
+#ifndef CL_CHECK_LEVEL
+#define CL_CHECK_LEVEL 1
+#endif
+
+// assert.h defines assert afresh, following NDEBUG, each time it is
+// included, so this turns off assertions in files included above too
+#if CL_CHECK_LEVEL == 0 && !defined(NDEBUG)
+#define NDEBUG
+#endif
+#include <assert.h>
+
+// Operations a list backend provides. The public functions in clist.c
+// check their arguments, convert negative positions to the equivalent
+// non-negative ones and do bounds checking before calling these, so
+// every pos passed to a backend is already in range: [0, length-1] for
+// nth and remove, [0, length] for insert. Backends keep list->length
+// up to date themselves.
+//
+// Lengths and positions are ptrdiff_t throughout, so that lists may
+// grow beyond INT_MAX elements; the int functions of the public API
+// convert at the boundary.
+//
+// A concurrent backend allows pop, CL_length, and push or append (as
+// documented for the backend) to be called from several threads at
+// once. It updates list->length atomically. The caller's checks may be
+// out of date by the time the backend runs, so its pop returns
+// INVALID_RETURN if it finds the list empty, and if a backend allows
+// positional operations to run concurrently, their pos may turn out to
+// be out of range: insert then returns false, and nth and remove
+// return INVALID_RETURN. Other backends' insert always returns true.
+struct _cl_ops
+{
+  void (*free)(CList list); // release everything except the list struct
+  bool (*check)(CList list); // whether the backend's invariants hold
+  void (*push)(CList list, CListElementType element);
+  CListElementType (*pop)(CList list); // list is not empty
+  void (*append)(CList list, CListElementType element);
+  CListElementType (*nth)(CList list, ptrdiff_t pos);
+  bool (*insert)(CList list, CListElementType element, ptrdiff_t pos);
+  CListElementType (*remove)(CList list, ptrdiff_t pos);
+  CList (*copy)(CList list);
+  ptrdiff_t (*insert_sorted)(CList list, CListElementType element);
+  void (*join)(CList list1, CList list2); // both lists use this backend
+  void (*reverse)(CList list);
+  void (*foreach)(CList list, CL_foreach64_callback callback, void *cb_data);
+  // optional: lay the nodes out again in list order, and measure how
+  // far they are from it (see CL_compact and CL_fragmentation)
+  void (*compact)(CList list);
+  double (*fragmentation)(CList list);
+  bool concurrent;
+};
+
+// A node of the default linked backend.
+//
+// Building with -DCL_DOUBLY_LINKED adds a prev link to every node, so
+// that positions counting from the end of the list (pos < 0) can be
+// reached by walking backward from the tail, and so that a node can be
+// unlinked without first locating its predecessor.
+//
+// Building with -DCL_PREFIX_CACHE adds the first 8 bytes of the
+// element, read as a big-endian integer, to every node. Comparing two
+// prefixes orders elements the same way strcmp does unless the
+// prefixes are equal, so most comparisons in CL_insert_sorted and
+// CL_sort need not dereference the element at all.
+struct _cl_node
+{
+  CListElementType element;
+#ifdef CL_PREFIX_CACHE
+  uint64_t prefix;
+#endif
+  struct _cl_node *next;
+#ifdef CL_DOUBLY_LINKED
+  struct _cl_node *prev;
+#endif
+};
+
+struct _clist
+{
+  // state of the default linked backend, used when ops is NULL
+  struct _cl_node *head;
+  struct _cl_node *tail;
+  CLNodePool pool; // where nodes come from, or NULL to use malloc
+  CLArena arena;   // arena holding the list and its nodes, or NULL
+
+  // the finger is the node most recently found by position, which the
+  // next search by position may start from; NULL if there is none
+  struct _cl_node *finger;
+  ptrdiff_t finger_pos;
+  size_t finger_hits;   // searches that started from the finger
+  size_t finger_misses; // searches that started from the head or tail
+
+  ptrdiff_t length;
+
+  // an owning list copies each element into its node; the node that
+  // held the most recently removed element is kept until the next
+  // removal so that the element returned stays valid
+  bool owning;
+  struct _cl_node *removed;
+
+  // a list loaded with CL_load_mapped keeps its snapshot file mapped,
+  // since its elements point into it; NULL otherwise
+  void *mapping;
+  size_t mapping_size;
+
+  // blocks of text that CL_append_lines cut elements out of, freed
+  // with the list
+  struct _cl_text_block *text;
+
+#ifdef CL_STATS
+  CLStats stats;
+  CLApi stats_api; // the call being counted, which searches are charged to
+#endif
+
+  // alternative backend, or NULL for the linked backend
+  const struct _cl_ops *ops;
+  void *impl; // backend-private state
+};
+
+// A block of text read by CL_append_lines (clist_lines.c)
+struct _cl_text_block
+{
+  struct _cl_text_block *next;
+  char data[];
+};
+
+/*
+ * Keep a block of text that elements of list point into: until the
+ * list is freed, or for a list in an arena, until the arena is reset
+ * or freed (defined in clist.c)
+ */
+void _CL_keep_text(CList list, struct _cl_text_block *block);
+
+// A task of a parallel job; see _CL_workers_run
+typedef void (*_CL_task_fn)(void *data, int task);
+
+/*
+ * Run a job of num_tasks tasks, calling fn(data, task) for each task
+ * from 0 to num_tasks-1, on up to num_threads threads of the shared
+ * worker pool (defined in clist_workers.c), counting the calling
+ * thread, and return when all of them have finished. Tasks may run in
+ * any order, and at the same time as each other. A job started from
+ * within a task runs in the calling thread.
+ */
+void _CL_workers_run(int num_threads, int num_tasks, _CL_task_fn fn, void *data);
+
+/*
+ * Return the number of threads a job asking for num_threads threads
+ * may use: num_threads <= 0 asks for one per online CPU
+ */
+int _CL_workers_threads(int num_threads);
+
+// Backends, defined in their own .c files
+extern const struct _cl_ops _CL_unrolled_ops;
+extern const struct _cl_ops _CL_indexed_ops;
+extern const struct _cl_ops _CL_concurrent_ops;
+extern const struct _cl_ops _CL_concurrent_queue_ops;
+extern const struct _cl_ops _CL_locked_ops;
+extern const struct _cl_ops _CL_compact_ops;
+
+
+#endif /* _CLIST_INTERNAL_H_ */
@@ -0,0 +1,255 @@
+/*
+ * clist_lines.c
+ *
+ * Appending the lines of a file to a list.
+ *
+ * The file is read in large blocks. Each line is cut out of the block
+ * where it lies, by overwriting its newline with a NUL, and the lines
+ * of a block are appended together with CL_append_array, so a list
+ * with a pool or arena allocates their nodes as one batch. Reads go into a block until it is full,
+ * so a source that returns short reads still fills whole blocks. A
+ * line that runs past the end of a block is moved to the front of the
+ * next one, which is made large enough that a long line is not copied
+ * again on every read. The blocks that lines were cut from stay with
+ * the list (list->text), or with its arena, until it is freed; an
+ * owning list copies the lines into its nodes instead, so its blocks
+ * are released straight away.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "clist.h"
+#include "clist_internal.h"
+
+// Number of bytes read into each block
+#define CL_LINES_READ_SIZE (1 << 20)
+
+// Reads up to size bytes from source into buf, returning the number
+// read, 0 at end of file, or -1 on an error
+typedef ssize_t (*_CL_read_fn)(void *source, char *buf, size_t size);
+
+/*
+ * _CL_read_fn for a stdio stream
+ */
+static ssize_t
+_CL_read_stream(void *source, char *buf, size_t size)
+{
+  FILE *file = (FILE *)source;
+
+  size_t n = fread(buf, 1, size, file);
+  if (n == 0 && ferror(file))
+    return -1;
+
+  return (ssize_t)n;
+}
+
+/*
+ * _CL_read_fn for a file descriptor
+ */
+static ssize_t
+_CL_read_fd(void *source, char *buf, size_t size)
+{
+  int fd = *(int *)source;
+
+  ssize_t n;
+  do
+    n = read(fd, buf, size);
+  while (n < 0 && errno == EINTR);
+
+  return n;
+}
+
+// Lines cut from a block, waiting to be appended together
+struct _cl_line_batch
+{
+  CListElementType *lines;
+  int num_lines;
+  int capacity;
+};
+
+/*
+ * Add a line to a batch
+ */
+static void
+_CL_batch_add(struct _cl_line_batch *batch, const char *line)
+{
+  if (batch->num_lines == batch->capacity)
+  {
+    batch->capacity = (batch->capacity > 0) ? 2 * batch->capacity : 1024;
+    batch->lines = (CListElementType *)realloc(batch->lines, (size_t)batch->capacity * sizeof(CListElementType));
+    assert(batch->lines);
+  }
+
+  batch->lines[batch->num_lines++] = line;
+}
+
+/*
+ * Allocate a block with room for capacity bytes of text and a NUL
+ */
+static struct _cl_text_block *
+_CL_new_block(size_t capacity)
+{
+  struct _cl_text_block *block =
+      (struct _cl_text_block *)malloc(sizeof(struct _cl_text_block) + capacity + 1);
+  assert(block);
+
+  return block;
+}
+
+/*
+ * Append the lines cut from a block to the list, and let go of the
+ * block: the list keeps it if its elements point into it, and it is
+ * freed otherwise. A block that is mostly unused, as the last one
+ * usually is, is first copied into one just large enough for its text,
+ * so that short reads at the end of a file do not pin a whole block.
+ *
+ * Parameters:
+ *   list     The list
+ *   block    The block
+ *   filled   Number of bytes of text in the block
+ *   batch    The lines cut from the block; emptied
+ *
+ * Returns: None
+ */
+static void
+_CL_retire_block(CList list, struct _cl_text_block *block, size_t filled,
+                 struct _cl_line_batch *batch)
+{
+  if (batch->num_lines == 0 || list->owning)
+  {
+    if (batch->num_lines > 0)
+      CL_append_array(list, batch->lines, batch->num_lines);
+    batch->num_lines = 0;
+    free(block);
+    return;
+  }
+
+  // the text used ends in a NUL, past the end of any line cut from it
+  block->data[filled] = '\0';
+  if (filled < CL_LINES_READ_SIZE / 2)
+  {
+    struct _cl_text_block *fitted = _CL_new_block(filled);
+    memcpy(fitted->data, block->data, filled + 1);
+    for (int i = 0; i < batch->num_lines; i++)
+      batch->lines[i] = fitted->data + (batch->lines[i] - block->data);
+    free(block);
+    block = fitted;
+  }
+
+  CL_append_array(list, batch->lines, batch->num_lines);
+  batch->num_lines = 0;
+  _CL_keep_text(list, block);
+}
+
+/*
+ * Append the lines read from a source to a list
+ *
+ * Parameters:
+ *   list      The list
+ *   read_fn   Reads from the source
+ *   source    The source
+ *
+ * Returns: The number of lines appended, or -1 on a read error
+ */
+static int
+_CL_append_lines(CList list, _CL_read_fn read_fn, void *source)
+{
+  int count = 0;
+  bool error = false;
+  struct _cl_line_batch batch = {NULL, 0, 0};
+
+  // reads go into the block until it is full, however little each
+  // read returns; the block always has room for a NUL past its text
+  size_t capacity = CL_LINES_READ_SIZE;
+  struct _cl_text_block *block = _CL_new_block(capacity);
+  size_t filled = 0;       // bytes of text in block
+  char *line = block->data; // start of the line not yet ended
+
+  for (;;)
+  {
+    ssize_t n = read_fn(source, block->data + filled, capacity - filled);
+    if (n < 0)
+    {
+      error = true;
+      n = 0;
+    }
+
+    // cut out every line that ends in what was just read; the
+    // unfinished line holds no newline, so the search starts after it
+    char *end = block->data + filled + n;
+    char *scan = block->data + filled;
+    char *newline;
+    while ((newline = memchr(scan, '\n', end - scan)) != NULL)
+    {
+      *newline = '\0';
+      _CL_batch_add(&batch, line);
+      line = scan = newline + 1;
+    }
+    filled += n;
+
+    if (n == 0)
+    {
+      // at the end of the file, a last line without a newline counts too
+      if (!error && line < end)
+      {
+        *end = '\0';
+        _CL_batch_add(&batch, line);
+      }
+      break;
+    }
+
+    if (filled < capacity)
+      continue;
+
+    // the block is full: the unfinished line moves to the front of the
+    // next one, which is made at least twice as large as the line, so a
+    // long line is copied only a number of times logarithmic in its
+    // length
+    size_t pending = end - line;
+    size_t next_capacity = CL_LINES_READ_SIZE;
+    while (next_capacity < 2 * pending)
+      next_capacity *= 2;
+
+    struct _cl_text_block *next_block = _CL_new_block(next_capacity);
+    memcpy(next_block->data, line, pending);
+
+    count += batch.num_lines;
+    _CL_retire_block(list, block, filled - pending, &batch);
+
+    block = next_block;
+    capacity = next_capacity;
+    filled = pending;
+    line = block->data;
+  }
+
+  count += batch.num_lines;
+  _CL_retire_block(list, block, filled, &batch);
+  free(batch.lines);
+
+  return error ? -1 : count;
+}
+
+// Documented in .h file
+int CL_append_lines(CList list, FILE *file)
+{
+  assert(list);
+  assert(file);
+
+  return _CL_append_lines(list, _CL_read_stream, file);
+}
+
+// Documented in .h file
+int CL_append_lines_fd(CList list, int fd)
+{
+  assert(list);
+  assert(fd >= 0);
+
+  return _CL_append_lines(list, _CL_read_fd, &fd);
+}
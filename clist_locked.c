@@ -0,0 +1,545 @@
+/*
+ * clist_locked.c
+ *
+ * Fine-grained locking backend for CList, built as a lazy list. Every
+ * node, and a sentinel node in front of the first element, has a lock
+ * of its own, but operations walk the list without taking any of
+ * them. Only once an operation has found where it acts does it lock
+ * the one or two nodes it changes, and then checks that they are
+ * still linked together; if another thread got there first, it starts
+ * again from the front.
+ *
+ * A node is removed in two steps, both under the locks of the node and
+ * its predecessor: it is first marked, so that operations which locked
+ * it before it went away see that it is gone, and then unlinked. A
+ * walk that is standing on a removed node can still follow its next
+ * link, so removed nodes are not freed at once but put on a retired
+ * list, which is freed whenever no operation is in progress (and at
+ * the latest by CL_free).
+ *
+ * Appends go through a tail pointer, which is only changed by a thread
+ * holding the lock of the last node, so appending does not walk the
+ * list. Since operations only hold locks for the length of a change,
+ * and locks are taken from the front of the list toward the end, they
+ * cannot deadlock, and operations on different nodes run in parallel.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "clist.h"
+#include "clist_internal.h"
+
+// Number of retired nodes that makes an operation try to free them
+#define CLL_RECLAIM_BATCH 64
+
+struct _cl_lnode
+{
+  pthread_mutex_t lock;         // guards next and marked
+  CListElementType element;     // never changes once the node is linked
+  struct _cl_lnode *next;       // read without the lock, atomically
+  bool marked;                  // set when the node is removed
+  struct _cl_lnode *next_retired;
+};
+
+struct _cl_locked
+{
+  struct _cl_lnode front; // sentinel; front.next is the first element's node
+  struct _cl_lnode *tail; // the last node, or &front; changed under its lock
+
+  // every operation holds reclaim for reading, so holding it for
+  // writing means no thread can be standing on a retired node
+  pthread_rwlock_t reclaim;
+  pthread_mutex_t retired_lock; // guards retired
+  struct _cl_lnode *retired;
+  size_t num_retired;
+};
+
+#define LOCKED(list) ((struct _cl_locked *)(list)->impl)
+
+// Atomic access to the links that walks read without locking
+#define NEXT(node) __atomic_load_n(&(node)->next, __ATOMIC_ACQUIRE)
+#define SET_NEXT(node, value) __atomic_store_n(&(node)->next, (value), __ATOMIC_RELEASE)
+#define TAIL(ll) __atomic_load_n(&(ll)->tail, __ATOMIC_ACQUIRE)
+#define SET_TAIL(ll, value) __atomic_store_n(&(ll)->tail, (value), __ATOMIC_RELEASE)
+
+/*
+ * Create (malloc) a new node holding element
+ */
+static struct _cl_lnode *
+_CLL_new_node(CListElementType element)
+{
+  struct _cl_lnode *node = (struct _cl_lnode *)malloc(sizeof(struct _cl_lnode));
+  assert(node);
+
+  pthread_mutex_init(&node->lock, NULL);
+  node->element = element;
+  node->next = NULL;
+  node->marked = false;
+  node->next_retired = NULL;
+
+  return node;
+}
+
+/*
+ * Deallocate a node, which must be unlinked and unlocked
+ */
+static void
+_CLL_free_node(struct _cl_lnode *node)
+{
+  pthread_mutex_destroy(&node->lock);
+  free(node);
+}
+
+/*
+ * Free the retired nodes, if no operation is in progress
+ */
+static void
+_CLL_reclaim(struct _cl_locked *ll)
+{
+  if (pthread_rwlock_trywrlock(&ll->reclaim) != 0)
+    return;
+
+  // no operation is running, so none can be retiring nodes either
+  struct _cl_lnode *node = ll->retired;
+  ll->retired = NULL;
+  __atomic_store_n(&ll->num_retired, 0, __ATOMIC_RELAXED);
+  pthread_rwlock_unlock(&ll->reclaim);
+
+  while (node != NULL)
+  {
+    struct _cl_lnode *next = node->next_retired;
+    _CLL_free_node(node);
+    node = next;
+  }
+}
+
+/*
+ * Start an operation that walks the list
+ */
+static inline void
+_CLL_enter(struct _cl_locked *ll)
+{
+  pthread_rwlock_rdlock(&ll->reclaim);
+}
+
+/*
+ * End an operation started with _CLL_enter, freeing the retired nodes
+ * once there are enough of them
+ */
+static inline void
+_CLL_leave(struct _cl_locked *ll)
+{
+  pthread_rwlock_unlock(&ll->reclaim);
+
+  if (__atomic_load_n(&ll->num_retired, __ATOMIC_RELAXED) >= CLL_RECLAIM_BATCH)
+    _CLL_reclaim(ll);
+}
+
+/*
+ * Put a node that has just been unlinked on the retired list; threads
+ * walking the list may still be standing on it
+ */
+static void
+_CLL_retire(struct _cl_locked *ll, struct _cl_lnode *node)
+{
+  pthread_mutex_lock(&ll->retired_lock);
+  node->next_retired = ll->retired;
+  ll->retired = node;
+  __atomic_fetch_add(&ll->num_retired, 1, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&ll->retired_lock);
+}
+
+/*
+ * Find the node before a position, walking from the front without
+ * locking
+ *
+ * Parameters:
+ *   ll     The list's state
+ *   pos    The position, at least 0
+ *
+ * Returns: The node before position pos (the sentinel for position 0),
+ *   or NULL if the list has fewer than pos elements
+ */
+static struct _cl_lnode *
+_CLL_find_before(struct _cl_locked *ll, ptrdiff_t pos)
+{
+  struct _cl_lnode *node = &ll->front;
+
+  for (; pos > 0 && node != NULL; pos--)
+    node = NEXT(node);
+
+  return node;
+}
+
+/*
+ * Link a new element in after a node
+ *
+ * Parameters:
+ *   list      The list
+ *   prev      The node to link after, locked by the caller and not
+ *             marked
+ *   element   The element
+ *
+ * Returns: None
+ */
+static void
+_CLL_link_after(CList list, struct _cl_lnode *prev, CListElementType element)
+{
+  struct _cl_lnode *node = _CLL_new_node(element);
+
+  // once linked, the node may be found and changed by other threads,
+  // so it stays locked until the tail points to it if it is last
+  pthread_mutex_lock(&node->lock);
+  node->next = prev->next;
+  SET_NEXT(prev, node);
+  if (node->next == NULL)
+    SET_TAIL(LOCKED(list), node);
+  pthread_mutex_unlock(&node->lock);
+  __atomic_fetch_add(&list->length, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * The operations below implement struct _cl_ops for locked lists; see
+ * clist_internal.h. All but free, check, join and reverse may run
+ * concurrently.
+ */
+
+static void
+_CLL_free(CList list)
+{
+  struct _cl_locked *ll = LOCKED(list);
+
+  struct _cl_lnode *node = ll->front.next;
+  while (node != NULL)
+  {
+    struct _cl_lnode *next = node->next;
+    _CLL_free_node(node);
+    node = next;
+  }
+
+  node = ll->retired;
+  while (node != NULL)
+  {
+    struct _cl_lnode *next = node->next_retired;
+    _CLL_free_node(node);
+    node = next;
+  }
+
+  pthread_mutex_destroy(&ll->front.lock);
+  pthread_rwlock_destroy(&ll->reclaim);
+  pthread_mutex_destroy(&ll->retired_lock);
+  free(ll);
+}
+
+static bool
+_CLL_check(CList list)
+{
+  struct _cl_locked *ll = LOCKED(list);
+
+  ptrdiff_t len = 0;
+  struct _cl_lnode *last = &ll->front;
+  for (struct _cl_lnode *node = ll->front.next; node != NULL; node = node->next)
+  {
+    if (node->marked || ++len > list->length)
+      return false;
+    last = node;
+  }
+
+  return len == list->length && ll->tail == last;
+}
+
+static bool
+_CLL_insert(CList list, CListElementType element, ptrdiff_t pos)
+{
+  struct _cl_locked *ll = LOCKED(list);
+  bool inserted = false;
+
+  _CLL_enter(ll);
+  for (;;)
+  {
+    struct _cl_lnode *prev = _CLL_find_before(ll, pos);
+    if (prev == NULL)
+      break;
+
+    pthread_mutex_lock(&prev->lock);
+    if (!prev->marked)
+    {
+      _CLL_link_after(list, prev, element);
+      pthread_mutex_unlock(&prev->lock);
+      inserted = true;
+      break;
+    }
+    pthread_mutex_unlock(&prev->lock);
+  }
+  _CLL_leave(ll);
+
+  return inserted;
+}
+
+static CListElementType
+_CLL_remove(CList list, ptrdiff_t pos)
+{
+  struct _cl_locked *ll = LOCKED(list);
+  CListElementType element = INVALID_RETURN;
+  bool removed = false;
+
+  _CLL_enter(ll);
+  while (!removed)
+  {
+    struct _cl_lnode *prev = _CLL_find_before(ll, pos);
+    if (prev == NULL)
+      break;
+    struct _cl_lnode *node = NEXT(prev);
+
+    pthread_mutex_lock(&prev->lock);
+    if (node == NULL)
+    {
+      // the list really ends here only if prev is still in it and
+      // still last
+      bool at_end = !prev->marked && prev->next == NULL;
+      pthread_mutex_unlock(&prev->lock);
+      if (at_end)
+        break;
+      continue;
+    }
+
+    pthread_mutex_lock(&node->lock);
+    if (!prev->marked && !node->marked && prev->next == node)
+    {
+      __atomic_store_n(&node->marked, true, __ATOMIC_RELAXED);
+      SET_NEXT(prev, node->next);
+      if (node->next == NULL)
+        SET_TAIL(ll, prev);
+      __atomic_fetch_sub(&list->length, 1, __ATOMIC_RELAXED);
+      element = node->element;
+      removed = true;
+    }
+    pthread_mutex_unlock(&node->lock);
+    pthread_mutex_unlock(&prev->lock);
+
+    if (removed)
+      _CLL_retire(ll, node);
+  }
+  _CLL_leave(ll);
+
+  return element;
+}
+
+static void
+_CLL_push(CList list, CListElementType element)
+{
+  _CLL_insert(list, element, 0);
+}
+
+static CListElementType
+_CLL_pop(CList list)
+{
+  return _CLL_remove(list, 0);
+}
+
+static void
+_CLL_append(CList list, CListElementType element)
+{
+  struct _cl_locked *ll = LOCKED(list);
+
+  // the tail only changes under the last node's lock, so once that lock
+  // is held and the node is still last, nothing can get in behind it
+  _CLL_enter(ll);
+  for (;;)
+  {
+    struct _cl_lnode *last = TAIL(ll);
+
+    pthread_mutex_lock(&last->lock);
+    if (!last->marked && last->next == NULL)
+    {
+      _CLL_link_after(list, last, element);
+      pthread_mutex_unlock(&last->lock);
+      break;
+    }
+    pthread_mutex_unlock(&last->lock);
+  }
+  _CLL_leave(ll);
+}
+
+static CListElementType
+_CLL_nth(CList list, ptrdiff_t pos)
+{
+  struct _cl_locked *ll = LOCKED(list);
+  CListElementType element = INVALID_RETURN;
+
+  _CLL_enter(ll);
+  struct _cl_lnode *prev = _CLL_find_before(ll, pos);
+  struct _cl_lnode *node = (prev != NULL) ? NEXT(prev) : NULL;
+  if (node != NULL)
+    element = node->element;
+  _CLL_leave(ll);
+
+  return element;
+}
+
+static void
+_CLL_foreach(CList list, CL_foreach64_callback callback, void *cb_data)
+{
+  struct _cl_locked *ll = LOCKED(list);
+
+  // removed nodes a walk passes through are skipped
+  size_t position = 0;
+  _CLL_enter(ll);
+  for (struct _cl_lnode *node = NEXT(&ll->front); node != NULL; node = NEXT(node))
+    if (!__atomic_load_n(&node->marked, __ATOMIC_RELAXED))
+      callback(position++, node->element, cb_data);
+  _CLL_leave(ll);
+}
+
+/*
+ * CL_foreach64 callback used by _CLL_copy; cb_data points to the last
+ * node of the copy
+ */
+static void
+_CLL_copy_element(size_t pos, CListElementType element, void *cb_data)
+{
+  struct _cl_lnode **last = (struct _cl_lnode **)cb_data;
+
+  (*last)->next = _CLL_new_node(element);
+  *last = (*last)->next;
+}
+
+static CList
+_CLL_copy(CList list)
+{
+  CList list_copy = CL_new_locked();
+
+  // the copy is private until returned, so its nodes are linked
+  // without locking them
+  struct _cl_lnode *last = &LOCKED(list_copy)->front;
+  _CLL_foreach(list, _CLL_copy_element, &last);
+  LOCKED(list_copy)->tail = last;
+
+  for (struct _cl_lnode *node = LOCKED(list_copy)->front.next; node != NULL; node = node->next)
+    list_copy->length++;
+
+  return list_copy;
+}
+
+static ptrdiff_t
+_CLL_insert_sorted(CList list, CListElementType element)
+{
+  struct _cl_locked *ll = LOCKED(list);
+  ptrdiff_t position;
+
+  _CLL_enter(ll);
+  for (;;)
+  {
+    // walk until the next node's element does not sort before the new
+    // one, then lock the node before it and make sure they are still
+    // neighbours
+    position = 0;
+    struct _cl_lnode *prev = &ll->front;
+    struct _cl_lnode *node = NEXT(prev);
+    while (node != NULL && strcmp(node->element, element) < 0)
+    {
+      prev = node;
+      node = NEXT(node);
+      position++;
+    }
+
+    pthread_mutex_lock(&prev->lock);
+    if (!prev->marked && prev->next == node)
+    {
+      _CLL_link_after(list, prev, element);
+      pthread_mutex_unlock(&prev->lock);
+      break;
+    }
+    pthread_mutex_unlock(&prev->lock);
+  }
+  _CLL_leave(ll);
+
+  return position;
+}
+
+static void
+_CLL_join(CList list1, CList list2)
+{
+  struct _cl_locked *ll1 = LOCKED(list1), *ll2 = LOCKED(list2);
+
+  if (ll2->front.next == NULL)
+    return;
+
+  ll1->tail->next = ll2->front.next;
+  ll1->tail = ll2->tail;
+  list1->length += list2->length;
+
+  ll2->front.next = NULL;
+  ll2->tail = &ll2->front;
+  list2->length = 0;
+}
+
+static void
+_CLL_reverse(CList list)
+{
+  struct _cl_locked *ll = LOCKED(list);
+  struct _cl_lnode *prev = NULL;
+  struct _cl_lnode *node = ll->front.next;
+
+  if (node != NULL)
+    ll->tail = node;
+
+  while (node != NULL)
+  {
+    struct _cl_lnode *next = node->next;
+    node->next = prev;
+    prev = node;
+    node = next;
+  }
+
+  ll->front.next = prev;
+}
+
+const struct _cl_ops _CL_locked_ops = {
+    .free = _CLL_free,
+    .check = _CLL_check,
+    .push = _CLL_push,
+    .pop = _CLL_pop,
+    .append = _CLL_append,
+    .nth = _CLL_nth,
+    .insert = _CLL_insert,
+    .remove = _CLL_remove,
+    .copy = _CLL_copy,
+    .insert_sorted = _CLL_insert_sorted,
+    .join = _CLL_join,
+    .reverse = _CLL_reverse,
+    .foreach = _CLL_foreach,
+    .concurrent = true,
+};
+
+// Documented in .h file
+CList CL_new_locked()
+{
+  CList list = CL_new();
+
+  struct _cl_locked *ll = (struct _cl_locked *)malloc(sizeof(struct _cl_locked));
+  assert(ll);
+
+  pthread_mutex_init(&ll->front.lock, NULL);
+  ll->front.element = NULL;
+  ll->front.next = NULL;
+  ll->front.marked = false;
+  ll->front.next_retired = NULL;
+  ll->tail = &ll->front;
+
+  pthread_rwlock_init(&ll->reclaim, NULL);
+  pthread_mutex_init(&ll->retired_lock, NULL);
+  ll->retired = NULL;
+  ll->num_retired = 0;
+
+  list->ops = &_CL_locked_ops;
+  list->impl = ll;
+
+  return list;
+}
@@ -0,0 +1,290 @@
+/*
+ * clist_snapshot.c
+ *
+ * Saving lists to binary snapshot files and loading them back.
+ *
+ * A snapshot is a header, then a table holding the offset of each
+ * element within the payload, then the payload itself: the characters
+ * of every element, each followed by its NUL, back to back. Numbers are
+ * stored in the byte order of the machine that wrote the file, which
+ * the header records, so that a mapped snapshot can be used where it
+ * lies. The header is a multiple of 8 bytes long, so the offset table
+ * of a mapped file is aligned.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <assert.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "clist.h"
+#include "clist_internal.h"
+
+#define CL_SNAPSHOT_MAGIC "CLSNAP01"
+
+// Appended to the path of a snapshot being saved, for the file it is
+// written to before it takes the snapshot's place
+#define CL_SNAPSHOT_TEMP_SUFFIX ".tmp"
+
+// Number of elements a load appends at a time
+#define CL_SNAPSHOT_LOAD_BATCH 1024
+
+// Written in the writer's byte order; reads differently on a machine
+// with another byte order
+#define CL_SNAPSHOT_BYTE_ORDER UINT64_C(0x0102030405060708)
+
+struct _cl_snapshot_header
+{
+  char magic[8];         // CL_SNAPSHOT_MAGIC, without its NUL
+  uint64_t byte_order;   // CL_SNAPSHOT_BYTE_ORDER
+  uint64_t length;       // number of elements
+  uint64_t payload_size; // bytes of payload
+};
+
+/*
+ * Write all of a buffer to a stream
+ *
+ * Returns: true on success, false on a write error
+ */
+static bool
+_CL_write(FILE *file, const void *data, size_t size)
+{
+  return size == 0 || fwrite(data, size, 1, file) == 1;
+}
+
+// Documented in .h file
+bool CL_save(CList list, const char *path)
+{
+  assert(list);
+  assert(path);
+
+  // take the elements out first, so that the offsets and the payload
+  // written describe the same elements
+  int length = CL_length(list);
+  CListElementType *elements = (CListElementType *)malloc(((size_t)length + 1) * sizeof(CListElementType));
+  uint64_t *offsets = (uint64_t *)malloc(((size_t)length + 1) * sizeof(uint64_t));
+  assert(elements && offsets);
+  length = CL_to_array(list, elements, length);
+
+  struct _cl_snapshot_header header;
+  memcpy(header.magic, CL_SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.byte_order = CL_SNAPSHOT_BYTE_ORDER;
+  header.length = (uint64_t)length;
+  header.payload_size = 0;
+  bool ok = true;
+  for (int i = 0; ok && i < length; i++)
+  {
+    // a NULL element cannot be saved
+    ok = (elements[i] != NULL);
+    if (ok)
+    {
+      offsets[i] = header.payload_size;
+      header.payload_size += strlen(elements[i]) + 1;
+    }
+  }
+
+  // the snapshot is written beside the file it replaces and renamed
+  // over it once it is safely on disk, so a failed save leaves any
+  // earlier snapshot as it was
+  char *temp_path = (char *)malloc(strlen(path) + sizeof(CL_SNAPSHOT_TEMP_SUFFIX));
+  assert(temp_path);
+  strcpy(temp_path, path);
+  strcat(temp_path, CL_SNAPSHOT_TEMP_SUFFIX);
+
+  FILE *file = ok ? fopen(temp_path, "wb") : NULL;
+  if (file == NULL)
+    ok = false;
+  else
+  {
+    ok = _CL_write(file, &header, sizeof(header)) &&
+         _CL_write(file, offsets, (size_t)length * sizeof(uint64_t));
+    for (int i = 0; ok && i < length; i++)
+      ok = _CL_write(file, elements[i], strlen(elements[i]) + 1);
+
+    ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (fclose(file) != 0)
+      ok = false;
+    ok = ok && rename(temp_path, path) == 0;
+    if (!ok)
+      remove(temp_path);
+  }
+
+  free(temp_path);
+  free(offsets);
+  free(elements);
+
+  return ok;
+}
+
+/*
+ * Read a whole file into memory, either by mapping it or by reading it
+ * into a malloc'd buffer
+ *
+ * Parameters:
+ *   path   The file
+ *   map    If true, map the file read-only
+ *   size   Set to the size of the file
+ *
+ * Returns: The file's contents, or NULL if it could not be read
+ */
+static void *
+_CL_read_file(const char *path, bool map, size_t *size)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  struct stat st;
+  void *data = NULL;
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+  {
+    *size = (size_t)st.st_size;
+
+    if (map)
+    {
+      data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED)
+        data = NULL;
+    }
+    else
+    {
+      data = malloc(*size);
+      assert(data);
+
+      size_t done = 0;
+      while (done < *size)
+      {
+        ssize_t n = read(fd, (char *)data + done, *size - done);
+        if (n <= 0)
+          break;
+        done += (size_t)n;
+      }
+
+      if (done < *size)
+      {
+        free(data);
+        data = NULL;
+      }
+    }
+  }
+
+  close(fd);
+  return data;
+}
+
+/*
+ * Check the header of a snapshot read into memory, and that the rest
+ * of the file has the size it gives
+ *
+ * Parameters:
+ *   data     The contents of the snapshot file
+ *   size     The size of the file
+ *
+ * Returns: The header, or NULL if data is not a valid snapshot
+ */
+static const struct _cl_snapshot_header *
+_CL_snapshot_header(const void *data, size_t size)
+{
+  const struct _cl_snapshot_header *header = (const struct _cl_snapshot_header *)data;
+
+  if (size < sizeof(*header) || memcmp(header->magic, CL_SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+      header->byte_order != CL_SNAPSHOT_BYTE_ORDER || header->length > INT_MAX)
+    return NULL;
+
+  // the offset table and the payload must fill the rest of the file
+  // exactly, and the payload must end with a NUL
+  size_t table_size = (size_t)header->length * sizeof(uint64_t);
+  if (size - sizeof(*header) < table_size ||
+      size - sizeof(*header) - table_size != header->payload_size)
+    return NULL;
+
+  const char *payload = (const char *)data + sizeof(*header) + table_size;
+  if (header->payload_size > 0 && payload[header->payload_size - 1] != '\0')
+    return NULL;
+
+  return header;
+}
+
+/*
+ * Load a snapshot into a new list
+ *
+ * Parameters:
+ *   path   The snapshot file
+ *   map    If true, map the file and point the elements into it;
+ *          otherwise read it and copy the elements into an owning list
+ *
+ * Returns: The new list, or NULL if the file could not be read or is
+ *   not a valid snapshot
+ */
+static CList
+_CL_load(const char *path, bool map)
+{
+  assert(path);
+
+  size_t size;
+  void *data = _CL_read_file(path, map, &size);
+  if (data == NULL)
+    return NULL;
+
+  const struct _cl_snapshot_header *header = _CL_snapshot_header(data, size);
+  CList list = NULL;
+  if (header != NULL)
+  {
+    const uint64_t *offsets = (const uint64_t *)(header + 1);
+    const char *payload = (const char *)(offsets + header->length);
+
+    // the elements go into the list straight from the offset table, a
+    // batch at a time, each offset checked on the way
+    list = map ? CL_new() : CL_new_owning();
+    CListElementType batch[CL_SNAPSHOT_LOAD_BATCH];
+    for (uint64_t i = 0; list != NULL && i < header->length; i += CL_SNAPSHOT_LOAD_BATCH)
+    {
+      int n = (header->length - i < CL_SNAPSHOT_LOAD_BATCH) ? (int)(header->length - i)
+                                                            : CL_SNAPSHOT_LOAD_BATCH;
+      for (int j = 0; list != NULL && j < n; j++)
+      {
+        if (offsets[i + j] >= header->payload_size)
+        {
+          CL_free(list);
+          list = NULL;
+        }
+        else
+          batch[j] = payload + offsets[i + j];
+      }
+
+      if (list != NULL)
+        CL_append_array(list, batch, n);
+    }
+  }
+
+  if (list != NULL && map)
+  {
+    list->mapping = data;
+    list->mapping_size = size;
+  }
+  else if (map)
+    munmap(data, size);
+  else
+    free(data);
+
+  return list;
+}
+
+// Documented in .h file
+CList CL_load(const char *path)
+{
+  return _CL_load(path, false);
+}
+
+// Documented in .h file
+CList CL_load_mapped(const char *path)
+{
+  return _CL_load(path, true);
+}
@@ -10,7 +10,13 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include "clist.h"
+#include "clist_generic.h"
+#include "clist_internal.h"
 
 // Some known testdata, for testing
 const char *testdata[] = {"Zero", "One", "Two", "Three", "Four", "Five",
@@ -61,6 +67,21 @@ static const int num_testdata = sizeof(testdata) / sizeof(testdata[0]);
     }                                                     \
   }
 
+/*
+ * Checks that two lists hold the same elements in the same order
+ *
+ * Returns: 1 if the lists match, 0 otherwise
+ */
+int _CL_same_contents(CList list, CList expected)
+{
+  int length = CL_length(expected);
+  test_assert(CL_length(list) == length);
+  for (int i = 0; i < length; i++)
+    test_assert(CL_nth(list, i) == CL_nth(expected, i));
+
+  return 1;
+}
+
 /*
  * Tests the CL_new, CL_push, CL_pop, and CL_free functions
  *
@@ -534,6 +555,371 @@ int test_cl_reverse()
   return 1;
 }
 
+/*
+ * Tests that operations at the tail of the list (append, insert at -1,
+ * remove at -1, join, reverse) keep the list consistent when mixed
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_tail_ops()
+{
+  CList list = CL_new();
+  CList other = CL_new();
+
+  // removing the only element, then appending, must not use a stale tail
+  CL_append(list, testdata[0]);
+  test_compare(CL_remove(list, -1), testdata[0]);
+  CL_append(list, testdata[1]);
+  test_assert(CL_length(list) == 1);
+  test_compare(CL_nth(list, -1), testdata[1]);
+
+  // popping the only element, then appending
+  test_compare(CL_pop(list), testdata[1]);
+  CL_append(list, testdata[2]);
+  CL_append(list, testdata[3]);
+  test_assert(CL_length(list) == 2);
+  test_compare(CL_nth(list, 0), testdata[2]);
+  test_compare(CL_nth(list, -1), testdata[3]);
+
+  // removing the tail repeatedly, appending in between
+  for (int i = 4; i < num_testdata; i++)
+    CL_append(list, testdata[i]);
+  test_compare(CL_remove(list, -1), testdata[num_testdata - 1]);
+  test_compare(CL_remove(list, CL_length(list) - 1), testdata[num_testdata - 2]);
+  CL_append(list, testdata[0]);
+  test_compare(CL_nth(list, -1), testdata[0]);
+  test_compare(CL_nth(list, -2), testdata[num_testdata - 3]);
+  test_assert(CL_length(list) == num_testdata - 3);
+
+  // insert at -1 and at length both append
+  test_assert(CL_insert(list, testdata[1], -1));
+  test_assert(CL_insert(list, testdata[2], CL_length(list)));
+  test_compare(CL_nth(list, -2), testdata[1]);
+  test_compare(CL_nth(list, -1), testdata[2]);
+
+  // walk the whole list from both ends
+  int len = CL_length(list);
+  for (int i = 0; i < len; i++)
+    test_compare(CL_nth(list, i), CL_nth(list, i - len));
+
+  // reversing swaps the ends, and appends go after the old head
+  CL_reverse(list);
+  test_compare(CL_nth(list, 0), testdata[2]);
+  test_compare(CL_nth(list, -1), testdata[2]);
+  CL_append(list, testdata[5]);
+  test_compare(CL_nth(list, -1), testdata[5]);
+  test_compare(CL_nth(list, -2), testdata[2]);
+
+  // joining an empty list keeps the tail; joining a full one moves it
+  CL_join(list, other);
+  test_compare(CL_nth(list, -1), testdata[5]);
+  CL_append(other, testdata[6]);
+  CL_append(other, testdata[7]);
+  CL_join(list, other);
+  test_assert(CL_length(other) == 0);
+  test_compare(CL_nth(list, -1), testdata[7]);
+  CL_append(list, testdata[8]);
+  test_compare(CL_nth(list, -2), testdata[7]);
+  test_compare(CL_nth(list, -1), testdata[8]);
+
+  // the emptied list is still usable at the tail
+  CL_append(other, testdata[9]);
+  test_assert(CL_length(other) == 1);
+  test_compare(CL_nth(other, -1), testdata[9]);
+
+  // an element sorting after the tail is appended
+  while (CL_length(other) > 0)
+    CL_pop(other);
+  test_assert(CL_insert_sorted(other, "b") == 0);
+  test_assert(CL_insert_sorted(other, "c") == 1);
+  test_assert(CL_insert_sorted(other, "c") == 1);
+  test_assert(CL_insert_sorted(other, "a") == 0);
+  test_compare(CL_nth(other, -1), "c");
+  CL_append(other, "d");
+  test_compare(CL_nth(other, 4), "d");
+
+  CL_free(list);
+  CL_free(other);
+
+  return 1;
+}
+
+/*
+ * Tests lists whose nodes come from a shared CLNodePool
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_pool()
+{
+  CLNodePool pool = CL_pool_new(8);
+  CLNodePoolStats stats;
+
+  CList list1 = CL_new_with_pool(pool);
+  CList list2 = CL_new_with_pool(pool);
+
+  // a fresh pool has nothing allocated
+  CL_pool_stats(pool, &stats);
+  test_assert(stats.slabs == 0 && stats.in_use == 0 && stats.allocs == 0);
+
+  // pooled lists behave like any other list
+  for (int i = 0; i < num_testdata; i++)
+    CL_append(list1, testdata[i]);
+  test_assert(CL_length(list1) == num_testdata);
+  for (int i = 0; i < num_testdata; i++)
+    test_compare(CL_nth(list1, i), testdata[i]);
+
+  // 21 nodes from 8-node slabs needs 3 slabs
+  CL_pool_stats(pool, &stats);
+  test_assert(stats.slabs == 3);
+  test_assert(stats.capacity == 24);
+  test_assert(stats.in_use == num_testdata);
+  test_assert(stats.free_nodes == 0);
+
+  // popped and removed nodes go to the free list and are reused
+  test_compare(CL_pop(list1), testdata[0]);
+  test_compare(CL_remove(list1, 3), testdata[4]);
+  CL_pool_stats(pool, &stats);
+  test_assert(stats.in_use == num_testdata - 2);
+  test_assert(stats.free_nodes == 2);
+  test_assert(stats.releases == 2);
+
+  CL_push(list2, testdata[0]);
+  CL_insert(list2, testdata[4], 1);
+  CL_pool_stats(pool, &stats);
+  test_assert(stats.free_nodes == 0);
+  test_assert(stats.slabs == 3);
+  test_assert(stats.peak_in_use == num_testdata);
+
+  // push/pop cycles do not grow the pool
+  for (int i = 0; i < 1000; i++)
+  {
+    CL_push(list2, testdata[i % num_testdata]);
+    test_compare(CL_pop(list2), testdata[i % num_testdata]);
+  }
+  CL_pool_stats(pool, &stats);
+  test_assert(stats.slabs == 3);
+  test_assert(stats.allocs == num_testdata + 2 + 1000);
+
+  // joining lists on the same pool relinks their nodes
+  CL_join(list1, list2);
+  test_assert(CL_length(list1) == num_testdata);
+  test_assert(CL_length(list2) == 0);
+  test_compare(CL_nth(list1, -2), testdata[0]);
+  test_compare(CL_nth(list1, -1), testdata[4]);
+
+  // copies draw from the same pool
+  CList list_copy = CL_copy(list1);
+  CL_pool_stats(pool, &stats);
+  test_assert(stats.in_use == 2 * num_testdata);
+  test_compare(CL_nth(list_copy, 0), testdata[1]);
+
+  // joining with a malloc'd list moves the elements across
+  CList plain = CL_new();
+  CL_append(plain, testdata[5]);
+  CL_append(plain, testdata[6]);
+  CL_join(list_copy, plain);
+  test_assert(CL_length(plain) == 0);
+  test_assert(CL_length(list_copy) == num_testdata + 2);
+  test_compare(CL_nth(list_copy, -2), testdata[5]);
+  test_compare(CL_nth(list_copy, -1), testdata[6]);
+  CL_join(plain, list_copy);
+  test_assert(CL_length(list_copy) == 0);
+  test_assert(CL_length(plain) == num_testdata + 2);
+  test_compare(CL_nth(plain, 0), testdata[1]);
+  CL_free(plain);
+
+  // freeing a list returns all its nodes at once
+  CL_free(list1);
+  CL_pool_stats(pool, &stats);
+  test_assert(stats.in_use == 0);
+  test_assert(stats.free_nodes == 2 * num_testdata + 2);
+
+  // the pool outlives CL_pool_free while lists still use it
+  CL_pool_free(pool);
+  CL_append(list2, testdata[7]);
+  test_compare(CL_nth(list2, 0), testdata[7]);
+  CL_free(list2);
+  CL_free(list_copy);
+
+  return 1;
+}
+
+/*
+ * Tests lists created in a CLArena
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_arena()
+{
+  // a tiny first block forces the arena to grow several times
+  CLArena arena = CL_arena_new(64);
+
+  CList list1 = CL_new_in_arena(arena);
+  CList list2 = CL_new_in_arena(arena);
+
+  test_assert(CL_length(list1) == 0);
+  test_invalid(CL_pop(list1));
+
+  for (int i = 0; i < 10000; i++)
+  {
+    CL_append(list1, testdata[i % num_testdata]);
+    CL_push(list2, testdata[i % num_testdata]);
+  }
+  test_assert(CL_length(list1) == 10000);
+  test_assert(CL_length(list2) == 10000);
+  test_compare(CL_nth(list1, 0), testdata[0]);
+  test_compare(CL_nth(list1, -1), testdata[9999 % num_testdata]);
+  test_compare(CL_nth(list2, 0), testdata[9999 % num_testdata]);
+
+  // removed nodes are reused by other lists in the arena
+  test_compare(CL_remove(list1, 1), testdata[1]);
+  test_compare(CL_pop(list1), testdata[0]);
+  CL_insert(list2, testdata[2], 5);
+  test_compare(CL_nth(list2, 5), testdata[2]);
+
+  // copies live in the same arena; joins between arena lists relink
+  CList list_copy = CL_copy(list1);
+  test_assert(CL_length(list_copy) == 9998);
+  CL_join(list_copy, list2);
+  test_assert(CL_length(list_copy) == 9998 + 10001);
+  test_assert(CL_length(list2) == 0);
+
+  // joins with a malloc'd list move the elements across
+  CList plain = CL_new();
+  CL_append(plain, testdata[3]);
+  CL_join(list2, plain);
+  test_compare(CL_nth(list2, 0), testdata[3]);
+  CL_append(plain, testdata[4]);
+  CL_join(plain, list2);
+  test_assert(CL_length(plain) == 2);
+  test_compare(CL_nth(plain, 1), testdata[3]);
+  CL_free(plain);
+
+  // freeing one arena list leaves the others intact
+  CL_free(list1);
+  test_compare(CL_nth(list_copy, 0), testdata[2]);
+
+  // after a reset the arena can be used for new lists
+  CL_arena_reset(arena);
+  list1 = CL_new_in_arena(arena);
+  for (int i = 0; i < num_testdata; i++)
+    CL_insert_sorted(list1, testdata[i]);
+  for (int i = 0; i < num_testdata; i++)
+    test_compare(CL_nth(list1, i), testdata_sorted[i]);
+
+  // destroying the arena releases everything left in it
+  CL_arena_free(arena);
+
+  return 1;
+}
+
+/*
+ * Tests that the finger speeds up sequential positional access and
+ * stays correct across edits
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_finger()
+{
+  CList list = CL_new();
+  CList expected = CL_new_indexed();
+  size_t hits, misses;
+
+  CL_finger_stats(list, &hits, &misses);
+  test_assert(hits == 0 && misses == 0);
+
+  for (int i = 0; i < 1000; i++)
+  {
+    CL_append(list, testdata[i % num_testdata]);
+    CL_append(expected, testdata[i % num_testdata]);
+  }
+
+  // a sequential scan misses only on its first walk
+  for (int i = 0; i < 1000; i++)
+    test_assert(CL_nth(list, i) == testdata[i % num_testdata]);
+  CL_finger_stats(list, &hits, &misses);
+  test_assert(misses == 1);
+  test_assert(hits == 1000 - 3);
+
+  // a random walk of edits and lookups near the finger, drifting
+  // forward, agrees with an indexed list
+  srand(7007);
+  int pos = 500;
+  for (int i = 0; i < 20000; i++)
+  {
+    int len = CL_length(expected);
+    pos += rand() % 6 - 2;
+    if (pos < 0 || pos >= len)
+      pos = len / 2;
+
+    const char *element = testdata[rand() % num_testdata];
+    switch (rand() % 7)
+    {
+    case 0:
+    case 1:
+      test_assert(CL_nth(list, pos) == CL_nth(expected, pos));
+      break;
+    case 2:
+      test_assert(CL_nth(list, pos - len) == CL_nth(expected, pos - len));
+      break;
+    case 3:
+      test_assert(CL_insert(list, element, pos) == CL_insert(expected, element, pos));
+      break;
+    case 4:
+      test_assert(CL_remove(list, pos) == CL_remove(expected, pos));
+      break;
+    case 5:
+      CL_push(list, element);
+      CL_push(expected, element);
+      break;
+    case 6:
+      test_assert(CL_pop(list) == CL_pop(expected));
+      break;
+    }
+  }
+  test_assert(_CL_same_contents(list, expected));
+  CL_finger_stats(list, &hits, &misses);
+  test_assert(hits > misses);
+
+  // edits through a cursor, reversal and joins keep the finger valid
+  test_assert(CL_nth(list, 100) == CL_nth(expected, 100));
+  CLCursor cursor = CL_cursor_begin(list);
+  for (int i = 0; i < 50; i++)
+    CL_cursor_next(cursor);
+  CL_cursor_insert_before(cursor, "x");
+  CL_insert(expected, "x", 50);
+  CL_cursor_remove(cursor);
+  CL_remove(expected, 51);
+  CL_cursor_free(cursor);
+  test_assert(CL_nth(list, 101) == CL_nth(expected, 101));
+
+  CL_reverse(list);
+  CL_reverse(expected);
+  test_assert(CL_nth(list, 100) == CL_nth(expected, 100));
+  test_assert(CL_nth(list, 101) == CL_nth(expected, 101));
+
+  CList other = CL_new();
+  CL_append(other, "a");
+  CL_append(other, "b");
+  CL_append(other, "c");
+  test_compare(CL_nth(other, 1), "b");
+  CL_join(list, other);
+  CL_append(expected, "a");
+  CL_append(expected, "b");
+  CL_append(expected, "c");
+  CL_append(other, "d");
+  CL_append(other, "e");
+  CL_append(other, "f");
+  test_compare(CL_nth(other, 1), "e");
+  test_assert(_CL_same_contents(list, expected));
+
+  CL_free(list);
+  CL_free(expected);
+  CL_free(other);
+
+  return 1;
+}
+
 /*
  * Converts a string to uppercase and prints it
  * Parameters:
@@ -615,115 +1001,2223 @@ int test_cl_foreach()
 }
 
 /*
- * A demonstration of how to use a CList, which also doubles as a
- * test case.
+ * Tests a list that uses an alternative backend by applying the same
+ * random sequence of operations to it and to a plain list, and
+ * checking that they always agree
  *
- * Returns: 1 if all tests pass, 0 otherwise.
+ * Parameters:
+ *   list   An empty list using the backend under test; it is freed
+ *   seed   Seed for the random sequence of operations
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
  */
-int sample_clist_usage()
+int _CL_check_backend(CList list, unsigned seed)
 {
-  CList list = CL_new();
+  CList expected = CL_new();
 
-  // new lists have length 0
+  // the empty-list behaviour matches the plain list
   test_assert(CL_length(list) == 0);
+  test_invalid(CL_pop(list));
+  test_invalid(CL_nth(list, 0));
+  test_invalid(CL_remove(list, -1));
+  test_assert(CL_insert(list, testdata[0], 1) == false);
 
-  CL_push(list, "alpha");   // push 'alpha' onto front of list
-  CL_push(list, "bravo");   // push 'bravo' onto front of list
-  CL_push(list, "charlie"); // push 'charlie' onto front of list
+  srand(seed);
+  for (int i = 0; i < 20000; i++)
+  {
+    const char *element = testdata[rand() % num_testdata];
+    int len = CL_length(expected);
+    int pos = (len > 0) ? rand() % (2 * len + 1) - len : 0;
+
+    switch (rand() % 8)
+    {
+    case 0:
+      CL_push(list, element);
+      CL_push(expected, element);
+      break;
+    case 1:
+      test_assert(CL_pop(list) == CL_pop(expected));
+      break;
+    case 2:
+      CL_append(list, element);
+      CL_append(expected, element);
+      break;
+    case 3:
+      test_assert(CL_nth(list, pos) == CL_nth(expected, pos));
+      break;
+    case 4:
+    case 5:
+      test_assert(CL_insert(list, element, pos) == CL_insert(expected, element, pos));
+      break;
+    case 6:
+    case 7:
+      test_assert(CL_remove(list, pos) == CL_remove(expected, pos));
+      break;
+    }
+
+    if (i % 1000 == 0 && !_CL_same_contents(list, expected))
+      return 0;
+  }
+  test_assert(_CL_same_contents(list, expected));
 
-  // list is now charlie, bravo, alpha
-  CL_print(list); // print out the list: charlie, bravo, alpha
-  test_assert(CL_length(list) == 3);
+  // drain and refill through the other operations
+  while (CL_length(expected) > 0)
+    test_assert(CL_remove(list, -1) == CL_remove(expected, -1));
+  test_assert(CL_length(list) == 0);
 
-  // pop the element off the front of the list, which should be 'charlie'
-  test_compare(CL_pop(list), "charlie");
-  test_assert(CL_length(list) == 2);
+  for (int i = 0; i < 500; i++)
+  {
+    const char *element = testdata[rand() % num_testdata];
+    test_assert(CL_insert_sorted(list, element) == CL_insert_sorted(expected, element));
+  }
+  test_assert(_CL_same_contents(list, expected));
+  for (int i = 1; i < CL_length(list); i++)
+    test_assert(strcmp(CL_nth(list, i - 1), CL_nth(list, i)) <= 0);
 
-  CL_insert(list, "delta", 2);    // insert 'delta' at position 2
-  CL_append(list, "echo");        // append 'echo' at end of list
-  CL_insert(list, "foxtrot", -2); // insert 'foxtrot' one before end
+  CList list_copy = CL_copy(list);
+  CList expected_copy = CL_copy(expected);
+  test_assert(_CL_same_contents(list_copy, expected_copy));
 
-  // list is now: bravo, alpha, delta, foxtrot, echo
-  test_assert(CL_length(list) == 5);
+  CL_reverse(list);
+  CL_reverse(expected);
+  test_assert(_CL_same_contents(list, expected));
 
-  // retrieve the 3rd element, numbering from 0, so it should be foxtrot
-  test_compare(CL_nth(list, 3), "foxtrot");
+  // join two lists using the backend, then one using it and a plain list
+  CL_join(list, list_copy);
+  CL_join(expected, expected_copy);
+  test_assert(CL_length(list_copy) == 0);
+  test_assert(_CL_same_contents(list, expected));
 
-  // list hasn't changed
-  test_assert(CL_length(list) == 5);
+  CList plain = CL_new();
+  CL_append(plain, testdata[1]);
+  CL_append(plain, testdata[2]);
+  CL_join(list, plain);
+  test_assert(CL_length(plain) == 0);
+  test_compare(CL_nth(list, -1), testdata[2]);
+  test_compare(CL_nth(list, -2), testdata[1]);
 
-  // now REMOVE the third element
-  test_compare(CL_remove(list, 3), "foxtrot");
-  test_assert(CL_length(list) == 4);
+  // foreach visits every element in order
+  CL_foreach(list_copy, _CL_print_uppercase, (void *)(intptr_t)CL_length(list_copy));
+  CL_append(list_copy, testdata[3]);
+  CL_append(list_copy, testdata[4]);
+  CL_foreach(list_copy, _CL_print_uppercase, (void *)(intptr_t)CL_length(list_copy));
+  CL_print(list_copy);
 
-  // list is now: bravo, alpha, delta, echo
+  CL_free(list);
+  CL_free(list_copy);
+  CL_free(expected);
+  CL_free(expected_copy);
+  CL_free(plain);
 
-  // make a copy of the list
-  CList list_copy = CL_copy(list);
+  return 1;
+}
 
-  test_assert(CL_length(list_copy) == 4);
+/*
+ * Tests lists created with CL_new_unrolled
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_unrolled()
+{
+  return _CL_check_backend(CL_new_unrolled(), 4004);
+}
 
-  // reverse the copy, so it is now echo, delta, alpha, bravo
-  CL_reverse(list_copy);
+/*
+ * Tests lists created with CL_new_indexed
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_indexed()
+{
+  if (!_CL_check_backend(CL_new_indexed(), 5005))
+    return 0;
 
-  // remove the first item from the copy
-  test_compare(CL_remove(list_copy, 0), "echo");
-  test_assert(CL_length(list_copy) == 3);
+  // positional access on a large list, from both ends
+  CList list = CL_new_indexed();
+  for (int i = 0; i < 100000; i++)
+    CL_append(list, testdata[i % num_testdata]);
 
-  // original list should be unchanged
-  test_assert(CL_length(list) == 4);
+  for (int i = 0; i < 100000; i += 997)
+  {
+    test_compare(CL_nth(list, i), testdata[i % num_testdata]);
+    test_compare(CL_nth(list, i - 100000), testdata[i % num_testdata]);
+  }
 
-  // join the two lists; note this operation empties list_copy
-  CL_join(list, list_copy);
+  // insert and remove in the middle shift later positions by one
+  test_assert(CL_insert(list, "middle", 50000));
+  test_compare(CL_nth(list, 50000), "middle");
+  test_compare(CL_nth(list, 50001), testdata[50000 % num_testdata]);
+  test_compare(CL_remove(list, -50001), "middle");
+  test_compare(CL_nth(list, 50000), testdata[50000 % num_testdata]);
+  test_assert(CL_length(list) == 100000);
 
-  // list is now: bravo, alpha, delta, echo, delta, alpha, bravo
-  // list_copy should be empty
-  test_assert(CL_length(list) == 7);
-  test_compare(CL_nth(list, 3), "echo");
-  test_assert(CL_length(list_copy) == 0);
+  // reversing and joining keep positions consistent
+  CL_reverse(list);
+  test_compare(CL_nth(list, 0), testdata[99999 % num_testdata]);
+  test_compare(CL_nth(list, -1), testdata[0]);
+  CList other = CL_new_indexed();
+  CL_append(other, "last");
+  CL_join(list, other);
+  test_compare(CL_nth(list, 100000), "last");
+  test_compare(CL_nth(list, 99999), testdata[0]);
 
-  // Lists must be destroyed
   CL_free(list);
-  CL_free(list_copy);
+  CL_free(other);
 
   return 1;
 }
 
-int main()
+/*
+ * Tests lists created with CL_new_compact
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_compact()
 {
-  int passed = 0;
-  int num_tests = 0;
+  if (!_CL_check_backend(CL_new_compact(), 6006))
+    return 0;
+
+  // released nodes are reused before the arrays grow, and copies and
+  // joins keep them
+  CList list = CL_new_compact();
+  for (int i = 0; i < 1000; i++)
+    CL_append(list, testdata[i % num_testdata]);
+  for (int i = 0; i < 500; i++)
+    test_compare(CL_remove(list, i), testdata[(2 * i) % num_testdata]);
+  test_assert(CL_validate(list));
+
+  CList copy = CL_copy(list);
+  for (int i = 0; i < 500; i++)
+    CL_insert(copy, "new", 2 * i);
+  test_assert(CL_validate(copy));
+  test_assert(CL_length(copy) == 1000);
+  test_assert(CL_length(list) == 500);
+  for (int i = 0; i < 500; i++)
+  {
+    test_compare(CL_nth(copy, 2 * i), "new");
+    test_compare(CL_nth(copy, 2 * i + 1), CL_nth(list, i));
+  }
 
-  num_tests++;
-  passed += test_cl_push_pop();
-  num_tests++;
-  passed += test_cl_append();
-  num_tests++;
-  passed += test_cl_nth();
+  CL_join(list, copy);
+  test_assert(CL_validate(list));
+  test_assert(CL_validate(copy));
+  test_assert(CL_length(list) == 1500);
+  test_assert(CL_length(copy) == 0);
+  test_compare(CL_nth(list, 500), "new");
+  test_compare(CL_nth(list, -1), testdata[999 % num_testdata]);
 
-  num_tests++;
-  passed += test_cl_insert();
+  // an emptied list can be refilled
+  CL_append(copy, "again");
+  test_compare(CL_nth(copy, 0), "again");
+  test_assert(CL_validate(copy));
 
-  num_tests++;
-  passed += test_cl_remove();
+  CL_free(list);
+  CL_free(copy);
 
-  num_tests++;
-  passed += sample_clist_usage();
+  return 1;
+}
 
-  num_tests++;
-  passed += test_cl_copy();
+/*
+ * Runs a filtering pass with a cursor over a list holding testdata,
+ * removing every element that starts with 'T' and inserting "x"
+ * before every element that starts with 'S'
+ *
+ * Parameters:
+ *   list   A list holding testdata, in order; it is freed
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int _CL_check_cursor(CList list)
+{
+  CList expected = CL_new();
+  for (int i = 0; i < num_testdata; i++)
+  {
+    if (testdata[i][0] == 'S')
+      CL_append(expected, "x");
+    if (testdata[i][0] != 'T')
+      CL_append(expected, testdata[i]);
+  }
 
-  num_tests++;
-  passed += test_cl_insert_sorted();
+  CLCursor cursor = CL_cursor_begin(list);
+  int i = 0;
+  while (!CL_cursor_at_end(cursor))
+  {
+    CListElementType element = CL_cursor_get(cursor);
+    test_compare(element, testdata[i]);
+    i++;
+
+    if (element[0] == 'T')
+    {
+      int pos = CL_cursor_pos(cursor);
+      test_compare(CL_cursor_remove(cursor), element);
+      test_assert(CL_cursor_pos(cursor) == pos);
+      continue;
+    }
+
+    if (element[0] == 'S')
+    {
+      CL_cursor_insert_before(cursor, "x");
+      test_compare(CL_cursor_get(cursor), element);
+      test_compare(CL_nth(list, CL_cursor_pos(cursor) - 1), "x");
+    }
+
+    test_assert(CL_cursor_next(cursor));
+  }
+  test_assert(i == num_testdata);
+
+  // at the end, the cursor cannot move, get or remove
+  test_assert(CL_cursor_pos(cursor) == CL_length(list));
+  test_assert(CL_cursor_next(cursor) == false);
+  test_invalid(CL_cursor_get(cursor));
+  test_invalid(CL_cursor_remove(cursor));
+
+  // inserting at the end appends
+  CL_cursor_insert_before(cursor, "end");
+  CL_append(expected, "end");
+  test_assert(_CL_same_contents(list, expected));
+  CL_cursor_free(cursor);
+
+  // removing the tail through a cursor, then appending
+  cursor = CL_cursor_begin(list);
+  while (CL_cursor_pos(cursor) < CL_length(list) - 1)
+    CL_cursor_next(cursor);
+  test_compare(CL_cursor_remove(cursor), "end");
+  test_assert(CL_cursor_at_end(cursor));
+  CL_cursor_free(cursor);
+  CL_append(list, "end");
+  test_compare(CL_nth(list, -1), "end");
+
+  // emptying the list through a cursor
+  cursor = CL_cursor_begin(list);
+  while (CL_length(list) > 0)
+    test_assert(CL_cursor_remove(cursor) != INVALID_RETURN);
+  test_assert(CL_cursor_at_end(cursor));
+  CL_cursor_insert_before(cursor, testdata[0]);
+  test_assert(CL_length(list) == 1);
+  test_compare(CL_nth(list, -1), testdata[0]);
+  CL_cursor_free(cursor);
 
-  num_tests++;
-  passed += test_cl_join();
+  CL_free(list);
+  CL_free(expected);
 
-  num_tests++;
-  passed += test_cl_reverse();
+  return 1;
+}
 
-  num_tests++;
-  passed += test_cl_foreach();
+/*
+ * Tests the CL_cursor functions, on plain lists and on lists using the
+ * other backends and allocators
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_cursor()
+{
+  // a cursor on an empty list is at the end
+  CList list = CL_new();
+  CLCursor cursor = CL_cursor_begin(list);
+  test_assert(CL_cursor_at_end(cursor));
+  test_assert(CL_cursor_pos(cursor) == 0);
+  test_invalid(CL_cursor_get(cursor));
+  CL_cursor_free(cursor);
+  CL_free(list);
+
+  CLNodePool pool = CL_pool_new(0);
+  CList lists[] = {CL_new(), CL_new_with_pool(pool), CL_new_unrolled(), CL_new_indexed()};
+  CL_pool_free(pool);
+
+  for (int l = 0; l < sizeof(lists) / sizeof(lists[0]); l++)
+  {
+    for (int i = 0; i < num_testdata; i++)
+      CL_append(lists[l], testdata[i]);
+    if (!_CL_check_cursor(lists[l]))
+      return 0;
+  }
+
+  return 1;
+}
+
+/*
+ * Runs the batch insertion and export functions on a list
+ *
+ * Parameters:
+ *   list   An empty list; it is freed
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int _CL_check_array(CList list)
+{
+  CListElementType out[2 * num_testdata + 8];
+
+  // empty batches and exports do nothing
+  CL_append_array(list, testdata, 0);
+  CL_push_array(list, testdata, 0);
+  test_assert(CL_insert_array(list, testdata, 0, 0));
+  test_assert(CL_length(list) == 0);
+  test_assert(CL_to_array(list, out, 10) == 0);
+
+  // append and export
+  CL_append_array(list, testdata, num_testdata);
+  test_assert(CL_length(list) == num_testdata);
+  test_assert(CL_to_array(list, out, num_testdata + 8) == num_testdata);
+  for (int i = 0; i < num_testdata; i++)
+    test_compare(out[i], testdata[i]);
+  test_assert(CL_to_array(list, out, 3) == 3);
+  test_compare(out[2], testdata[2]);
+
+  // push_array behaves like repeated pushes
+  CL_push_array(list, testdata_sorted, 3);
+  test_compare(CL_nth(list, 0), testdata_sorted[2]);
+  test_compare(CL_nth(list, 1), testdata_sorted[1]);
+  test_compare(CL_nth(list, 2), testdata_sorted[0]);
+  test_compare(CL_nth(list, 3), testdata[0]);
+
+  // insert_array in the middle, at the end and from the end
+  test_assert(CL_insert_array(list, testdata_sorted + 10, 2, 5));
+  test_compare(CL_nth(list, 5), testdata_sorted[10]);
+  test_compare(CL_nth(list, 6), testdata_sorted[11]);
+  test_compare(CL_nth(list, 7), testdata[2]);
+  test_assert(CL_insert_array(list, testdata_sorted + 12, 2, -1));
+  test_compare(CL_nth(list, -2), testdata_sorted[12]);
+  test_compare(CL_nth(list, -1), testdata_sorted[13]);
+  test_assert(CL_insert_array(list, testdata_sorted + 14, 2, -2));
+  test_compare(CL_nth(list, -4), testdata_sorted[12]);
+  test_compare(CL_nth(list, -3), testdata_sorted[14]);
+  test_compare(CL_nth(list, -2), testdata_sorted[15]);
+  test_compare(CL_nth(list, -1), testdata_sorted[13]);
+  test_assert(CL_length(list) == num_testdata + 9);
+
+  // out of range positions leave the list unchanged
+  test_assert(CL_insert_array(list, testdata, 2, CL_length(list) + 1) == false);
+  test_assert(CL_insert_array(list, testdata, 2, -CL_length(list) - 2) == false);
+  test_assert(CL_length(list) == num_testdata + 9);
+
+  // the batch-built nodes can be removed and added to individually
+  test_compare(CL_remove(list, 5), testdata_sorted[10]);
+  test_compare(CL_pop(list), testdata_sorted[2]);
+  CL_append(list, "end");
+  test_compare(CL_nth(list, -1), "end");
+  test_assert(CL_length(list) == num_testdata + 8);
+
+  CL_free(list);
+
+  return 1;
+}
+
+/*
+ * Tests CL_append_array, CL_push_array, CL_insert_array and
+ * CL_to_array on every kind of list
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_array()
+{
+  CLNodePool pool = CL_pool_new(4);
+  CLArena arena = CL_arena_new(0);
+
+  // a non-empty plain list takes the batch too
+  CList nonempty = CL_new();
+  CL_append(nonempty, "first");
+  CL_append_array(nonempty, testdata, num_testdata);
+  test_assert(CL_length(nonempty) == num_testdata + 1);
+  test_compare(CL_nth(nonempty, 1), testdata[0]);
+  test_compare(CL_nth(nonempty, -1), testdata[num_testdata - 1]);
+
+  // an empty plain list joined with a batch-built one takes its nodes
+  CList built = CL_new();
+  CList joined = CL_new();
+  CL_append_array(built, testdata, num_testdata);
+  CL_join(joined, built);
+  test_assert(CL_length(joined) == num_testdata);
+  test_compare(CL_nth(joined, -1), testdata[num_testdata - 1]);
+  CL_join(joined, nonempty);
+  test_assert(CL_length(joined) == 2 * num_testdata + 1);
+  test_compare(CL_nth(joined, num_testdata), "first");
+  CL_free(built);
+  CL_free(nonempty);
+  CL_free(joined);
+
+  CList lists[] = {CL_new(), CL_new_with_pool(pool), CL_new_in_arena(arena),
+                   CL_new_unrolled(), CL_new_indexed(), CL_new_compact()};
+  for (int l = 0; l < sizeof(lists) / sizeof(lists[0]); l++)
+    if (!_CL_check_array(lists[l]))
+      return 0;
+
+  CL_pool_free(pool);
+  CL_arena_free(arena);
+
+  return 1;
+}
+
+/*
+ * Compares elements by their first character only, so that the
+ * stability of a sort can be observed
+ */
+int _CL_compare_first_char(CListElementType a, CListElementType b)
+{
+  return (unsigned char)a[0] - (unsigned char)b[0];
+}
+
+/*
+ * Sorts a list and checks the result
+ *
+ * Parameters:
+ *   list   An empty list; it is freed
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int _CL_check_sort(CList list)
+{
+  // sorting empty and single-element lists does nothing
+  CL_sort(list, NULL);
+  test_assert(CL_length(list) == 0);
+  CL_append(list, testdata[0]);
+  CL_sort(list, NULL);
+  test_compare(CL_nth(list, 0), testdata[0]);
+  CL_pop(list);
+
+  // the default order is the one CL_insert_sorted uses
+  CL_append_array(list, testdata, num_testdata);
+  CL_sort(list, NULL);
+  for (int i = 0; i < num_testdata; i++)
+    test_compare(CL_nth(list, i), testdata_sorted[i]);
+  test_compare(CL_nth(list, -1), testdata_sorted[num_testdata - 1]);
+
+  // the list is fully usable afterwards
+  test_assert(CL_insert_sorted(list, "Mmmm") == 7);
+  CL_append(list, "zz");
+  test_compare(CL_nth(list, -1), "zz");
+  test_compare(CL_nth(list, -2), testdata_sorted[num_testdata - 1]);
+  CL_reverse(list);
+  CL_sort(list, NULL);
+  test_compare(CL_nth(list, 7), "Mmmm");
+
+  // sorting is stable: keys are a letter followed by their original
+  // position, and only the letter is compared
+  while (CL_length(list) > 0)
+    CL_pop(list);
+  char keys[200][8];
+  srand(9009);
+  for (int i = 0; i < 200; i++)
+  {
+    sprintf(keys[i], "%c%d", 'a' + rand() % 5, i);
+    CL_append(list, keys[i]);
+  }
+  CL_sort(list, _CL_compare_first_char);
+  for (int i = 1; i < CL_length(list); i++)
+  {
+    CListElementType a = CL_nth(list, i - 1), b = CL_nth(list, i);
+    test_assert(a[0] <= b[0]);
+    test_assert(a[0] < b[0] || atoi(a + 1) < atoi(b + 1));
+  }
+
+  // a larger random list
+  while (CL_length(list) > 0)
+    CL_pop(list);
+  srand(9009);
+  for (int i = 0; i < 50000; i++)
+    CL_push(list, testdata[rand() % num_testdata]);
+  CL_sort(list, NULL);
+  test_assert(CL_length(list) == 50000);
+  CListElementType prev = CL_nth(list, 0);
+  CLCursor cursor = CL_cursor_begin(list);
+  for (; !CL_cursor_at_end(cursor); CL_cursor_next(cursor))
+  {
+    test_assert(strcmp(prev, CL_cursor_get(cursor)) <= 0);
+    prev = CL_cursor_get(cursor);
+  }
+  CL_cursor_free(cursor);
+
+  CL_free(list);
+
+  return 1;
+}
+
+/*
+ * Tests sorted operations on elements that share long prefixes, are
+ * prefixes of one another, or contain bytes above 0x7F, which must
+ * all still follow the rules for strcmp
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_sort_prefixes()
+{
+  const char *elements[] = {"abcdefgh", "abcdefghi", "abcdefgh2", "abcdefgh1",
+                            "abcdefg", "abcdefgz", "", "a", "ab", "\xFF", "\x7F",
+                            "abcdefgh\xFF", "abcdefgh", "Abcdefgh", "abcdefgH",
+                            "zzzzzzzzzzzzzzzz", "zzzzzzzzzzzzzzzy"};
+  const int num_elements = sizeof(elements) / sizeof(elements[0]);
+
+  CList list = CL_new();
+  for (int i = 0; i < num_elements; i++)
+  {
+    int pos = CL_insert_sorted(list, elements[i]);
+    test_assert(CL_nth(list, pos) == elements[i]);
+  }
+
+  for (int i = 1; i < num_elements; i++)
+    test_assert(strcmp(CL_nth(list, i - 1), CL_nth(list, i)) <= 0);
+
+  CList sorted = CL_new();
+  CL_append_array(sorted, elements, num_elements);
+  CL_sort(sorted, strcmp);
+  test_assert(_CL_same_contents(sorted, list));
+
+  CL_reverse(sorted);
+  CL_sort(sorted, NULL);
+  for (int i = 1; i < num_elements; i++)
+    test_assert(strcmp(CL_nth(sorted, i - 1), CL_nth(sorted, i)) <= 0);
+
+  CL_free(list);
+  CL_free(sorted);
+
+  return 1;
+}
+
+/*
+ * Tests the CL_sort function on every kind of list
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_sort()
+{
+  CLNodePool pool = CL_pool_new(0);
+  CLArena arena = CL_arena_new(0);
+
+  CList lists[] = {CL_new(), CL_new_with_pool(pool), CL_new_in_arena(arena),
+                   CL_new_unrolled(), CL_new_indexed(), CL_new_compact()};
+  for (int l = 0; l < sizeof(lists) / sizeof(lists[0]); l++)
+    if (!_CL_check_sort(lists[l]))
+      return 0;
+
+  CL_pool_free(pool);
+  CL_arena_free(arena);
+
+  return 1;
+}
+
+/*
+ * Tests the CL_sort_parallel function against CL_sort
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_sort_parallel()
+{
+  // keys are a letter followed by their original position, so that
+  // sorting on the letter alone shows up any instability
+  const int n = 20000;
+  char(*keys)[8] = malloc(n * sizeof(*keys));
+  srand(1717);
+  for (int i = 0; i < n; i++)
+    sprintf(keys[i], "%c%d", 'a' + rand() % 26, i);
+
+  CLNodePool pool = CL_pool_new(0);
+  const int thread_counts[] = {1, 2, 3, 7, 0};
+  for (int t = 0; t < 5; t++)
+  {
+    for (int c = 0; c < 2; c++)
+    {
+      CL_compare_fn cmp = (c == 0) ? _CL_compare_first_char : NULL;
+      CList list = (t % 2 == 0) ? CL_new() : CL_new_with_pool(pool);
+      for (int i = 0; i < n; i++)
+        CL_append(list, keys[i]);
+      CList expected = CL_copy(list);
+
+      CL_sort(expected, cmp);
+      CL_sort_parallel(list, cmp, thread_counts[t]);
+      test_assert(CL_length(list) == n);
+      test_assert(_CL_same_contents(list, expected));
+
+      // the tail and the prev links are right
+      test_assert(CL_nth(list, -1) == CL_nth(expected, -1));
+      test_assert(CL_nth(list, -n / 3) == CL_nth(expected, -n / 3));
+      CL_append(list, "~");
+      test_compare(CL_nth(list, n), "~");
+
+      CL_free(list);
+      CL_free(expected);
+    }
+  }
+
+  // short lists and other backends are sorted too
+  CList lists[] = {CL_new(), CL_new_unrolled(), CL_new_indexed()};
+  for (int l = 0; l < 3; l++)
+  {
+    CL_sort_parallel(lists[l], NULL, 4);
+    test_assert(CL_length(lists[l]) == 0);
+    CL_append_array(lists[l], testdata, num_testdata);
+    CL_sort_parallel(lists[l], strcmp, 4);
+    for (int i = 0; i < num_testdata; i++)
+      test_compare(CL_nth(lists[l], i), testdata_sorted[i]);
+    CL_free(lists[l]);
+  }
+
+  CL_pool_free(pool);
+  free(keys);
+
+  return 1;
+}
+
+// Generic list instantiations, for testing
+struct _cl_point
+{
+  int x, y;
+};
+#define _CL_point_cmp(a, b) CLIST_CMP_SCALAR((a).x, (b).x)
+
+CLIST_DEFINE(CLInt64List, int64_t, CLIST_CMP_SCALAR)
+CLIST_DEFINE(CLPointList, struct _cl_point, _CL_point_cmp)
+CLIST_DEFINE(CLStrList, const char *, strcmp)
+
+/*
+ * Foreach callback for CLInt64List: checks that each element equals
+ * its position times the int64_t pointed to by cb_data
+ */
+void _CL_int64_multiple(size_t pos, int64_t element, void *cb_data)
+{
+  assert(element == (int64_t)pos * *(int64_t *)cb_data);
+}
+
+/*
+ * Tests lists generated by CLIST_DEFINE
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_generic()
+{
+  int64_t value;
+
+  // positional operations, against the same operations on a CList of
+  // the same values
+  CLInt64List ints = CLInt64List_new();
+  test_assert(CLInt64List_length(ints) == 0);
+  test_assert(!CLInt64List_pop(ints, &value));
+  test_assert(!CLInt64List_nth(ints, 0, &value));
+  test_assert(!CLInt64List_remove(ints, -1, NULL));
+
+  for (int i = 0; i < 10; i++)
+    CLInt64List_append(ints, i * 3);
+  CLInt64List_foreach(ints, _CL_int64_multiple, &(int64_t){3});
+
+  test_assert(CLInt64List_insert(ints, -1, 0));
+  test_assert(CLInt64List_insert(ints, 100, -1));
+  test_assert(CLInt64List_insert(ints, 50, 5));
+  test_assert(!CLInt64List_insert(ints, 0, 14));
+  test_assert(!CLInt64List_insert(ints, 0, -15));
+  test_assert(CLInt64List_length(ints) == 13);
+
+  test_assert(CLInt64List_nth(ints, 0, &value) && value == -1);
+  test_assert(CLInt64List_nth(ints, 5, &value) && value == 50);
+  test_assert(CLInt64List_nth(ints, -1, &value) && value == 100);
+  test_assert(CLInt64List_nth(ints, -13, &value) && value == -1);
+  test_assert(!CLInt64List_nth(ints, 13, &value));
+  test_assert(!CLInt64List_nth(ints, -14, &value));
+
+  test_assert(CLInt64List_remove(ints, 5, &value) && value == 50);
+  test_assert(CLInt64List_remove(ints, -1, &value) && value == 100);
+  test_assert(CLInt64List_pop(ints, &value) && value == -1);
+  CLInt64List_foreach(ints, _CL_int64_multiple, &(int64_t){3});
+
+  // appending after removing the tail must use the new tail
+  CLInt64List_append(ints, 30);
+  test_assert(CLInt64List_nth(ints, -1, &value) && value == 30);
+  test_assert(CLInt64List_remove(ints, -1, NULL));
+
+  // reverse, copy, join
+  CLInt64List_reverse(ints);
+  test_assert(CLInt64List_nth(ints, 0, &value) && value == 27);
+  CLInt64List copy = CLInt64List_copy(ints);
+  CLInt64List_reverse(copy);
+  CLInt64List_join(copy, ints);
+  test_assert(CLInt64List_length(ints) == 0);
+  test_assert(CLInt64List_length(copy) == 20);
+  test_assert(CLInt64List_nth(copy, 9, &value) && value == 27);
+  test_assert(CLInt64List_nth(copy, 10, &value) && value == 27);
+  CLInt64List_join(ints, copy);
+  test_assert(CLInt64List_length(ints) == 20);
+  CLInt64List_append(ints, -5);
+  test_assert(CLInt64List_nth(ints, -1, &value) && value == -5);
+
+  // sorting
+  CLInt64List_sort(ints);
+  test_assert(CLInt64List_nth(ints, 0, &value) && value == -5);
+  for (int i = 1; i < 21; i++)
+  {
+    int64_t prev;
+    CLInt64List_nth(ints, i - 1, &prev);
+    CLInt64List_nth(ints, i, &value);
+    test_assert(prev <= value);
+  }
+  CLInt64List_append(ints, 1000);
+  test_assert(CLInt64List_insert_sorted(ints, 0) == 1);
+  test_assert(CLInt64List_insert_sorted(ints, 2000) == 23);
+  test_assert(CLInt64List_insert_sorted(ints, -10) == 0);
+
+  CLInt64List_free(ints);
+  CLInt64List_free(copy);
+
+  // struct elements, stored by value; sorting by x is stable in y
+  CLPointList points = CLPointList_new();
+  for (int i = 0; i < 20; i++)
+    CLPointList_push(points, (struct _cl_point){(i * 7) % 4, i});
+  CLPointList_sort(points);
+  struct _cl_point prev, point;
+  CLPointList_nth(points, 0, &prev);
+  for (int i = 1; i < 20; i++)
+  {
+    CLPointList_nth(points, i, &point);
+    test_assert(prev.x < point.x || (prev.x == point.x && prev.y > point.y));
+    prev = point;
+  }
+  test_assert(CLPointList_insert_sorted(points, (struct _cl_point){1, -1}) == 5);
+  CLPointList_free(points);
+
+  // a string list, which must order like a CList
+  CLStrList strs = CLStrList_new();
+  CList list = CL_new();
+  for (int i = 0; i < num_testdata; i++)
+    test_assert(CLStrList_insert_sorted(strs, testdata[i]) ==
+                CL_insert_sorted(list, testdata[i]));
+  for (int i = 0; i < num_testdata; i++)
+  {
+    const char *element;
+    test_assert(CLStrList_nth(strs, i, &element));
+    test_assert(element == testdata_sorted[i] || strcmp(element, testdata_sorted[i]) == 0);
+  }
+  CLStrList_free(strs);
+  CL_free(list);
+
+  return 1;
+}
+
+/*
+ * Tests owning lists, created with CL_new_owning
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_owning()
+{
+  char buffer[32];
+
+  // elements are copied, so the caller's buffer can be reused
+  CList list = CL_new_owning();
+  for (int i = 0; i < num_testdata; i++)
+  {
+    strcpy(buffer, testdata[i]);
+    CL_append(list, buffer);
+  }
+  strcpy(buffer, "Minus one");
+  CL_push(list, buffer);
+  strcpy(buffer, "Middle");
+  test_assert(CL_insert(list, buffer, 10));
+  strcpy(buffer, "Clobbered");
+
+  test_assert(CL_length(list) == num_testdata + 2);
+  test_assert(strcmp(CL_nth(list, 0), "Minus one") == 0);
+  test_assert(strcmp(CL_nth(list, 10), "Middle") == 0);
+  for (int i = 0; i < num_testdata; i++)
+  {
+    const char *element = CL_nth(list, i + 1 + (i >= 9));
+    test_assert(element != testdata[i]);
+    test_assert(strcmp(element, testdata[i]) == 0);
+  }
+
+  // a removed element stays valid until the next removal
+  const char *popped = CL_pop(list);
+  test_assert(strcmp(popped, "Minus one") == 0);
+  const char *removed = CL_remove(list, 9);
+  test_assert(strcmp(removed, "Middle") == 0);
+  removed = CL_remove(list, -1);
+  test_assert(strcmp(removed, "Twenty") == 0);
+  test_assert(CL_remove(list, 100) == INVALID_RETURN);
+  test_assert(strcmp(removed, "Twenty") == 0);
+  CL_append(list, removed);
+  test_assert(CL_length(list) == num_testdata);
+
+  // batch insertion, sorting and insert_sorted work on owned copies
+  const char *more[] = {"Alpha", "Omega"};
+  CL_insert_array(list, more, 2, 5);
+  test_assert(strcmp(CL_nth(list, 6), "Omega") == 0);
+  CL_sort(list, NULL);
+  test_assert(strcmp(CL_nth(list, 0), "Alpha") == 0);
+  strcpy(buffer, "Nineteenth");
+  test_assert(CL_insert_sorted(list, buffer) == 10);
+  strcpy(buffer, "Clobbered");
+  test_assert(strcmp(CL_nth(list, 10), "Nineteenth") == 0);
+
+  // copies own their elements too
+  CList copy = CL_copy(list);
+  test_assert(CL_length(copy) == CL_length(list));
+  for (int i = 0; i < CL_length(list); i++)
+  {
+    test_assert(CL_nth(copy, i) != CL_nth(list, i));
+    test_assert(strcmp(CL_nth(copy, i), CL_nth(list, i)) == 0);
+  }
+
+  // cursor removal
+  CLCursor cursor = CL_cursor_begin(copy);
+  removed = CL_cursor_remove(cursor);
+  test_assert(strcmp(removed, "Alpha") == 0);
+  CL_cursor_free(cursor);
+
+  // joining onto an owning list relinks; onto an empty plain list, the
+  // plain list becomes owning
+  CList plain = CL_new();
+  CL_join(plain, copy);
+  test_assert(CL_length(copy) == 0);
+  CL_free(copy);
+  CL_join(list, plain);
+  test_assert(CL_length(plain) == 0);
+  test_assert(CL_length(list) == 2 * num_testdata + 5);
+  strcpy(buffer, "Owned");
+  CL_append(plain, buffer);
+  strcpy(buffer, "Clobbered");
+  test_assert(strcmp(CL_nth(plain, 0), "Owned") == 0);
+  CL_free(plain);
+
+  // joining an owning list onto a list that cannot own its strings, a
+  // non-empty one or one with a pool, arena or another backend, is
+  // refused and leaves both lists as they were
+  CLNodePool pool = CL_pool_new(0);
+  CList refusers[] = {CL_new(), CL_new_with_pool(pool), CL_new_unrolled()};
+  CL_append(refusers[0], "Plain");
+  for (int r = 0; r < 3; r++)
+  {
+    int length = CL_length(refusers[r]);
+    CL_join(refusers[r], list);
+    test_assert(CL_length(refusers[r]) == length);
+    test_assert(CL_length(list) == 2 * num_testdata + 5);
+    test_assert(CL_validate(refusers[r]) && CL_validate(list));
+    CL_free(refusers[r]);
+  }
+  CL_pool_free(pool);
+
+  // an empty owning list keeps copying when a pooled or arena list is
+  // joined to it, so the elements outlive the strings they came from
+  CLArena arena = CL_arena_new(0);
+  pool = CL_pool_new(0);
+  CList sources[] = {CL_new_with_pool(pool), CL_new_in_arena(arena)};
+  for (int src = 0; src < 2; src++)
+  {
+    char *original = strdup("Original");
+    CL_append(sources[src], original);
+    CList own = CL_new_owning();
+    CL_join(own, sources[src]);
+    free(original);
+    test_compare(CL_nth(own, 0), "Original");
+
+    char later[16] = "Later";
+    CL_append(own, later);
+    strcpy(later, "Overwritten");
+    test_compare(CL_nth(own, 1), "Later");
+    test_assert(CL_validate(own));
+    CL_free(own);
+    CL_free(sources[src]);
+  }
+  CL_pool_free(pool);
+  CL_arena_free(arena);
+
+  // elements of a plain list are copied when joined to an owning list
+  CList strings = CL_new();
+  CL_append(strings, buffer);
+  CL_join(list, strings);
+  strcpy(buffer, "Changed");
+  test_assert(strcmp(CL_nth(list, -1), "Clobbered") == 0);
+  CL_free(strings);
+
+  CL_free(list);
+
+  return 1;
+}
+
+// Shape of the concurrent list stress tests
+#define SHARED_THREADS 8
+#define SHARED_ROUNDS 50000
+
+// One thread of a concurrent list stress test
+struct _cl_shared_worker
+{
+  CList list;
+  bool fifo;             // append rather than push
+  const char *tokens;    // SHARED_ROUNDS distinct elements to add
+  const char **popped;   // every element this thread popped
+  int num_popped;
+};
+
+/*
+ * Thread body for the concurrent list stress tests: adds each of the
+ * worker's tokens in turn, popping one element after each
+ */
+void *_CL_shared_worker(void *arg)
+{
+  struct _cl_shared_worker *worker = (struct _cl_shared_worker *)arg;
+
+  for (int i = 0; i < SHARED_ROUNDS; i++)
+  {
+    if (worker->fifo)
+      CL_append(worker->list, &worker->tokens[i]);
+    else
+      CL_push(worker->list, &worker->tokens[i]);
+
+    const char *element = CL_pop(worker->list);
+    if (element != INVALID_RETURN)
+      worker->popped[worker->num_popped++] = element;
+  }
+
+  return NULL;
+}
+
+/*
+ * Runs SHARED_THREADS threads adding to and popping from list at
+ * once, and checks that every element added was popped exactly once,
+ * either by a thread or by draining the list afterward. For a queue,
+ * also checks that each thread popped the elements added by any one
+ * thread in the order they were added.
+ *
+ * Parameters:
+ *   list   The list to share
+ *   fifo   If true, threads append to the list; if false, they push
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int _CL_check_shared_list(CList list, bool fifo)
+{
+  const int total = SHARED_THREADS * SHARED_ROUNDS;
+  char *tokens = (char *)calloc(total, 1);
+  char *seen = (char *)calloc(total, 1);
+  struct _cl_shared_worker workers[SHARED_THREADS];
+  pthread_t threads[SHARED_THREADS];
+
+  for (int t = 0; t < SHARED_THREADS; t++)
+  {
+    workers[t].list = list;
+    workers[t].fifo = fifo;
+    workers[t].tokens = &tokens[t * SHARED_ROUNDS];
+    workers[t].popped = (const char **)malloc(SHARED_ROUNDS * sizeof(const char *));
+    workers[t].num_popped = 0;
+    test_assert(pthread_create(&threads[t], NULL, _CL_shared_worker, &workers[t]) == 0);
+  }
+
+  int num_popped = 0;
+  for (int t = 0; t < SHARED_THREADS; t++)
+  {
+    pthread_join(threads[t], NULL);
+    num_popped += workers[t].num_popped;
+  }
+
+  test_assert(CL_length(list) == total - num_popped);
+
+  for (int t = 0; t < SHARED_THREADS; t++)
+  {
+    int last_popped[SHARED_THREADS];
+    for (int u = 0; u < SHARED_THREADS; u++)
+      last_popped[u] = -1;
+
+    for (int i = 0; i < workers[t].num_popped; i++)
+    {
+      int token = workers[t].popped[i] - tokens;
+      test_assert(token >= 0 && token < total && !seen[token]);
+      seen[token] = 1;
+
+      if (fifo)
+      {
+        test_assert(token > last_popped[token / SHARED_ROUNDS]);
+        last_popped[token / SHARED_ROUNDS] = token;
+      }
+    }
+    free(workers[t].popped);
+  }
+
+  const char *element;
+  while ((element = CL_pop(list)) != INVALID_RETURN)
+  {
+    test_assert(!seen[element - tokens]);
+    seen[element - tokens] = 1;
+  }
+  for (int i = 0; i < total; i++)
+    test_assert(seen[i]);
+  test_assert(CL_length(list) == 0);
+
+  free(tokens);
+  free(seen);
+
+  return 1;
+}
+
+// Shape of the concurrent length test: producers add more elements
+// than consumers take, in different counts per thread
+#define LENGTH_PRODUCERS 3
+#define LENGTH_CONSUMERS 2
+#define LENGTH_ADDS 40000
+#define LENGTH_POPS 50000
+
+// One thread of the concurrent length test
+struct _cl_length_worker
+{
+  CList list;
+  bool fifo;      // append rather than push
+  int count;      // elements to add, or to pop if negative
+  bool *done;     // set once every producer and consumer has finished
+  size_t highest; // the greatest length this thread saw
+};
+
+/*
+ * Thread body for the concurrent length test: adds count elements, or
+ * pops -count elements, retrying while the list is empty and reading
+ * the length after each pop, which is when it would drop below zero;
+ * or, with a count of 0, samples the list's length until told to stop
+ */
+void *_CL_length_worker(void *arg)
+{
+  struct _cl_length_worker *worker = (struct _cl_length_worker *)arg;
+
+  if (worker->count == 0)
+    while (!__atomic_load_n(worker->done, __ATOMIC_ACQUIRE))
+    {
+      size_t length = CL_length64(worker->list);
+      if (length > worker->highest)
+        worker->highest = length;
+    }
+
+  for (int i = 0; i < worker->count; i++)
+  {
+    if (worker->fifo)
+      CL_append(worker->list, "token");
+    else
+      CL_push(worker->list, "token");
+  }
+
+  for (int i = 0; i < -worker->count; i++)
+  {
+    while (CL_pop(worker->list) == INVALID_RETURN)
+      ;
+    size_t length = CL_length64(worker->list);
+    if (length > worker->highest)
+      worker->highest = length;
+  }
+
+  return NULL;
+}
+
+/*
+ * Samples the length of a concurrent list while several threads add
+ * to it and take from it, and checks that it never goes out of range:
+ * an element counted only after it is published can be popped, and
+ * uncounted, first, which would wrap the length around below zero
+ *
+ * Parameters:
+ *   list   An empty list, created with CL_new_concurrent or
+ *          CL_new_concurrent_queue; it is freed
+ *   fifo   If true, threads append to the list; if false, they push
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int _CL_check_shared_length(CList list, bool fifo)
+{
+  const int workers_count = LENGTH_PRODUCERS + LENGTH_CONSUMERS;
+  struct _cl_length_worker workers[LENGTH_PRODUCERS + LENGTH_CONSUMERS + 1];
+  pthread_t threads[LENGTH_PRODUCERS + LENGTH_CONSUMERS + 1];
+  bool done = false;
+
+  // the sampler is the last thread
+  for (int t = 0; t <= workers_count; t++)
+  {
+    workers[t].list = list;
+    workers[t].fifo = fifo;
+    workers[t].done = &done;
+    workers[t].highest = 0;
+    if (t < LENGTH_PRODUCERS)
+      workers[t].count = LENGTH_ADDS + t;
+    else if (t < workers_count)
+      workers[t].count = -(LENGTH_POPS + t);
+    else
+      workers[t].count = 0;
+    test_assert(pthread_create(&threads[t], NULL, _CL_length_worker, &workers[t]) == 0);
+  }
+
+  int added = 0, popped = 0;
+  for (int t = 0; t < workers_count; t++)
+  {
+    pthread_join(threads[t], NULL);
+    if (workers[t].count > 0)
+      added += workers[t].count;
+    else
+      popped -= workers[t].count;
+  }
+  __atomic_store_n(&done, true, __ATOMIC_RELEASE);
+  pthread_join(threads[workers_count], NULL);
+
+  for (int t = 0; t <= workers_count; t++)
+    test_assert(workers[t].highest <= (size_t)added);
+  test_assert(CL_length(list) == added - popped);
+  test_assert(CL_validate(list));
+
+  CL_free(list);
+
+  return 1;
+}
+
+/*
+ * Tests a concurrent list, single-threaded and then shared between
+ * threads (clist_bench -s compares its throughput with a plain list
+ * behind a mutex)
+ *
+ * Parameters:
+ *   list   The list, created with CL_new_concurrent or
+ *          CL_new_concurrent_queue
+ *   fifo   true for a queue, false for a stack
+ *   seed   Seed for the single-threaded test
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int _CL_check_concurrent(CList list, bool fifo, unsigned seed)
+{
+  CList copy = CL_copy(list);
+  int passed = _CL_check_backend(list, seed);
+
+  for (int round = 0; passed && round < 3; round++)
+    passed = _CL_check_shared_list(copy, fifo);
+  CL_free(copy);
+
+  return passed;
+}
+
+/*
+ * Tests lists created with CL_new_concurrent
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_concurrent()
+{
+  if (!_CL_check_shared_length(CL_new_concurrent(), false))
+    return 0;
+
+  return _CL_check_concurrent(CL_new_concurrent(), false, 6006);
+}
+
+/*
+ * Tests lists created with CL_new_concurrent_queue
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_concurrent_queue()
+{
+  if (!_CL_check_shared_length(CL_new_concurrent_queue(), true))
+    return 0;
+
+  return _CL_check_concurrent(CL_new_concurrent_queue(), true, 7007);
+}
+
+// Shape of the locked list stress test
+#define LOCKED_THREADS 8
+#define LOCKED_KEYS 500
+
+// One thread of the locked list stress test
+struct _cl_locked_worker
+{
+  CList list;
+  char (*keys)[16];      // keys to insert, shared by all threads
+  int first_key;         // this thread inserts keys first_key,
+  int key_step;          //   first_key + key_step, ...
+  int num_ops;
+  unsigned seed;
+  const char **removed; // every element this thread removed
+  int num_removed;
+};
+
+/*
+ * Thread body for the locked list stress test: inserts its keys in
+ * sorted order, removing an element at a random position after every
+ * fourth insertion, and reading one after every other
+ */
+void *_CL_locked_worker(void *arg)
+{
+  struct _cl_locked_worker *worker = (struct _cl_locked_worker *)arg;
+
+  for (int i = 0; i < worker->num_ops; i++)
+  {
+    CL_insert_sorted(worker->list, worker->keys[worker->first_key + i * worker->key_step]);
+
+    int pos = rand_r(&worker->seed) % (CL_length(worker->list) + 1);
+    if (i % 4 == 3)
+    {
+      const char *element = CL_remove(worker->list, pos);
+      if (element != INVALID_RETURN)
+        worker->removed[worker->num_removed++] = element;
+    }
+    else
+    {
+      const char *element = CL_nth(worker->list, -pos - 1);
+      assert(element == INVALID_RETURN || element[0] == 'k');
+    }
+
+    // every slot CL_to_array reports must have been filled, even if
+    // other threads shortened the list during the copy
+    if (i % 50 == 49)
+    {
+      const char *front[64] = {NULL};
+      int copied = CL_to_array(worker->list, front, 64);
+      for (int j = 0; j < copied; j++)
+        assert(front[j] != NULL && front[j][0] == 'k');
+    }
+  }
+
+  return NULL;
+}
+
+/*
+ * Tests lists created with CL_new_locked, single-threaded and then
+ * with threads inserting, removing and reading at once (clist_bench -s
+ * measures how they scale with the number of threads)
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_locked()
+{
+  if (!_CL_check_backend(CL_new_locked(), 8008))
+    return 0;
+
+  const int total = LOCKED_THREADS * LOCKED_KEYS;
+  char(*keys)[16] = malloc(total * sizeof(*keys));
+  for (int i = 0; i < total; i++)
+    snprintf(keys[i], sizeof(keys[i]), "k%08d", i);
+
+  // every thread inserts keys from across the whole range, so threads
+  // work all along the list at once
+  CList list = CL_new_locked();
+  struct _cl_locked_worker workers[LOCKED_THREADS];
+  pthread_t threads[LOCKED_THREADS];
+  for (int t = 0; t < LOCKED_THREADS; t++)
+  {
+    workers[t].list = list;
+    workers[t].keys = keys;
+    workers[t].first_key = t;
+    workers[t].key_step = LOCKED_THREADS;
+    workers[t].num_ops = LOCKED_KEYS;
+    workers[t].seed = t;
+    workers[t].removed = (const char **)malloc(LOCKED_KEYS * sizeof(const char *));
+    workers[t].num_removed = 0;
+    test_assert(pthread_create(&threads[t], NULL, _CL_locked_worker, &workers[t]) == 0);
+  }
+
+  // every key was either removed by exactly one thread or is still in
+  // the list, which is in order
+  char *seen = (char *)calloc(total, 1);
+  int num_removed = 0;
+  for (int t = 0; t < LOCKED_THREADS; t++)
+  {
+    pthread_join(threads[t], NULL);
+    for (int i = 0; i < workers[t].num_removed; i++)
+    {
+      int key = (workers[t].removed[i] - keys[0]) / sizeof(keys[0]);
+      test_assert(!seen[key]);
+      seen[key] = 1;
+    }
+    num_removed += workers[t].num_removed;
+    free(workers[t].removed);
+  }
+
+  test_assert(CL_length(list) == total - num_removed);
+  const char *prev = NULL;
+  const char *element;
+  while ((element = CL_pop(list)) != INVALID_RETURN)
+  {
+    int key = (element - keys[0]) / sizeof(keys[0]);
+    test_assert(!seen[key]);
+    seen[key] = 1;
+    test_assert(prev == NULL || strcmp(prev, element) < 0);
+    prev = element;
+  }
+  for (int i = 0; i < total; i++)
+    test_assert(seen[i]);
+  free(seen);
+  CL_free(list);
+
+  free(keys);
+
+  return 1;
+}
+
+// Where _CL_record_element writes down what it was passed
+struct _cl_record
+{
+  const char **seen; // seen[pos] is the element passed with pos
+  int calls;
+  CList inner; // if not NULL, traversed from inside each call
+};
+
+/*
+ * CL_parallel_foreach callback; may run in several threads at once
+ */
+void _CL_record_element(int pos, CListElementType element, void *cb_data)
+{
+  struct _cl_record *record = (struct _cl_record *)cb_data;
+
+  record->seen[pos] = element;
+  __atomic_fetch_add(&record->calls, 1, __ATOMIC_RELAXED);
+
+  // a parallel traversal started from a callback runs in its thread
+  if (record->inner != NULL)
+  {
+    const char *inner_seen[4];
+    struct _cl_record inner = {inner_seen, 0, NULL};
+    CL_parallel_foreach(record->inner, _CL_record_element, &inner, 0);
+    assert(inner.calls == CL_length(record->inner));
+  }
+}
+
+/*
+ * Tests CL_parallel_foreach
+ *
+ * Returns: 1 if all tests pass, 0 otherwise.
+ */
+int test_cl_parallel_foreach()
+{
+  const int lengths[] = {0, 1, 5, 1000};
+  const int thread_counts[] = {1, 3, 8, 0};
+
+  // distinct elements, so that a call with the wrong position shows up
+  char(*keys)[16] = malloc(1000 * sizeof(*keys));
+  for (int i = 0; i < 1000; i++)
+    snprintf(keys[i], sizeof(keys[i]), "k%08d", i);
+
+  for (int kind = 0; kind < 3; kind++)
+  {
+    for (int l = 0; l < 4; l++)
+    {
+      CList list = (kind == 0) ? CL_new() : (kind == 1) ? CL_new_unrolled() : CL_new_indexed();
+      for (int i = 0; i < lengths[l]; i++)
+        CL_append(list, keys[i]);
+
+      const char **seen = malloc((lengths[l] + 1) * sizeof(const char *));
+      for (int t = 0; t < 4; t++)
+      {
+        struct _cl_record record = {seen, 0, NULL};
+        memset(seen, 0, (lengths[l] + 1) * sizeof(const char *));
+
+        CL_parallel_foreach(list, _CL_record_element, &record, thread_counts[t]);
+
+        test_assert(record.calls == lengths[l]);
+        for (int i = 0; i < lengths[l]; i++)
+          test_assert(seen[i] == CL_nth(list, i));
+      }
+
+      free(seen);
+      CL_free(list);
+    }
+  }
+
+  // callbacks that traverse another list in parallel
+  CList list = CL_new();
+  CList inner = CL_new();
+  for (int i = 0; i < 100; i++)
+    CL_push(list, keys[i]);
+  for (int i = 0; i < 3; i++)
+    CL_push(inner, testdata[i]);
+
+  const char *seen[100];
+  struct _cl_record record = {seen, 0, inner};
+  CL_parallel_foreach(list, _CL_record_element, &record, 4);
+  test_assert(record.calls == 100);
+  for (int i = 0; i < 100; i++)
+    test_assert(seen[i] == CL_nth(list, i));
+
+  // nothing happens without a callback or cb_data
+  CL_parallel_foreach(list, NULL, &record, 4);
+  CL_parallel_foreach(list, _CL_record_element, NULL, 4);
+  test_assert(record.calls == 100);
+
+  CL_free(inner);
+  CL_free(list);
+  free(keys);
+
+  return 1;
+}
+
+/*
+ * Tests CL_save, CL_load and CL_load_mapped
+ *
+ * Returns: 1 if all tests pass, 0 otherwise.
+ */
+int test_cl_snapshot()
+{
+  char path[] = "/tmp/clist_test_XXXXXX";
+  int fd = mkstemp(path);
+  test_assert(fd >= 0);
+  close(fd);
+
+  CList lists[] = {CL_new(), CL_new_unrolled(), CL_new_owning()};
+  for (int l = 0; l < 3; l++)
+  {
+    // an empty list round-trips
+    test_assert(CL_save(lists[l], path));
+    for (int map = 0; map < 2; map++)
+    {
+      CList loaded = map ? CL_load_mapped(path) : CL_load(path);
+      test_assert(loaded != NULL);
+      test_assert(CL_length(loaded) == 0);
+      CL_free(loaded);
+    }
+
+    CL_append_array(lists[l], testdata, num_testdata);
+    CL_insert(lists[l], "", 3);
+    test_assert(CL_save(lists[l], path));
+
+    for (int map = 0; map < 2; map++)
+    {
+      CList loaded = map ? CL_load_mapped(path) : CL_load(path);
+      test_assert(loaded != NULL);
+      test_assert(CL_length(loaded) == CL_length(lists[l]));
+      for (int i = 0; i < CL_length(lists[l]); i++)
+      {
+        test_compare(CL_nth(loaded, i), CL_nth(lists[l], i));
+        test_assert(CL_nth(loaded, i) != CL_nth(lists[l], i));
+      }
+
+      // the loaded list can be changed like any other
+      CL_push(loaded, "Front");
+      test_compare(CL_remove(loaded, 4), "");
+      CL_append(loaded, "Back");
+      CL_sort(loaded, NULL);
+      test_compare(CL_nth(loaded, 0), "Back");
+      test_assert(CL_length(loaded) == num_testdata + 2);
+      CL_free(loaded);
+    }
+  }
+
+  // saving from a list of another backend gives the same file
+  test_assert(CL_save(lists[1], path));
+  CList loaded = CL_load_mapped(path);
+  test_assert(CL_length(loaded) == CL_length(lists[0]));
+  for (int i = 0; i < CL_length(loaded); i++)
+    test_compare(CL_nth(loaded, i), CL_nth(lists[0], i));
+  CL_free(loaded);
+
+  // a save that fails, here on a NULL element, leaves the snapshot
+  // already there as it was, and no temporary file
+  CList with_null = CL_copy(lists[0]);
+  CL_append(with_null, NULL);
+  test_assert(!CL_save(with_null, path));
+  CL_free(with_null);
+  char temp_path[sizeof(path) + 4];
+  snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+  test_assert(access(temp_path, F_OK) != 0);
+  loaded = CL_load(path);
+  test_assert(loaded != NULL && CL_length(loaded) == CL_length(lists[0]));
+  CL_free(loaded);
+
+  // a list longer than a load batch round-trips, and an offset out of
+  // range in a later batch is caught
+  CList long_list = CL_new();
+  for (int i = 0; i < 5000; i++)
+    CL_append(long_list, testdata[i % num_testdata]);
+  test_assert(CL_save(long_list, path));
+  for (int map = 0; map < 2; map++)
+  {
+    loaded = map ? CL_load_mapped(path) : CL_load(path);
+    test_assert(loaded != NULL);
+    for (int i = 0; i < 5000; i++)
+      test_compare(CL_nth(loaded, i), testdata[i % num_testdata]);
+    CL_free(loaded);
+  }
+  CL_free(long_list);
+
+  FILE *file = fopen(path, "r+b");
+  test_assert(file != NULL);
+  uint64_t bad_offset = UINT64_MAX;
+  fseek(file, 32 + 4000 * sizeof(uint64_t), SEEK_SET);
+  fwrite(&bad_offset, sizeof(bad_offset), 1, file);
+  fclose(file);
+  test_assert(CL_load(path) == NULL);
+  test_assert(CL_load_mapped(path) == NULL);
+  test_assert(CL_save(lists[0], path));
+
+  // a truncated or corrupt snapshot, or a missing file, does not load
+  file = fopen(path, "r+b");
+  test_assert(file != NULL);
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, size - 1, SEEK_SET);
+  fputc('x', file);
+  fclose(file);
+  test_assert(CL_load(path) == NULL);
+  test_assert(CL_load_mapped(path) == NULL);
+  test_assert(truncate(path, size / 2) == 0);
+  test_assert(CL_load(path) == NULL);
+  test_assert(CL_load_mapped(path) == NULL);
+
+  remove(path);
+  test_assert(CL_load(path) == NULL);
+  test_assert(CL_load_mapped(path) == NULL);
+
+  for (int l = 0; l < 3; l++)
+    CL_free(lists[l]);
+
+  return 1;
+}
+
+// Shape of the short reads test: PIPE_WRITES writes of PIPE_CHUNK
+// bytes, each holding PIPE_CHUNK / 8 lines of 7 characters
+#define PIPE_CHUNK 4096
+#define PIPE_WRITES 200
+
+/*
+ * Thread body for the short reads test: writes lines to a pipe, a
+ * chunk at a time, then closes it
+ */
+void *_CL_pipe_writer(void *arg)
+{
+  int fd = *(int *)arg;
+  char chunk[PIPE_CHUNK];
+  for (int i = 0; i < PIPE_CHUNK; i += 8)
+    memcpy(&chunk[i], "abcdefg\n", 8);
+
+  for (int i = 0; i < PIPE_WRITES; i++)
+    if (write(fd, chunk, sizeof(chunk)) != sizeof(chunk))
+      break;
+  close(fd);
+
+  return NULL;
+}
+
+/*
+ * Tests CL_append_lines and CL_append_lines_fd
+ *
+ * Returns: 1 if all tests pass, 0 otherwise.
+ */
+int test_cl_append_lines()
+{
+  char path[] = "/tmp/clist_test_XXXXXX";
+  int fd = mkstemp(path);
+  test_assert(fd >= 0);
+  close(fd);
+
+  // enough short lines to fill several read blocks, with a line that
+  // spans more than one block in the middle, and a last line with no
+  // newline
+  const int num_short = 300000;
+  const size_t long_length = 3 * 1024 * 1024 + 5;
+  char *long_line = malloc(long_length + 1);
+  memset(long_line, 'x', long_length);
+  long_line[long_length] = '\0';
+
+  FILE *file = fopen(path, "w");
+  test_assert(file != NULL);
+  for (int i = 0; i < num_short; i++)
+  {
+    fprintf(file, "%s\n", (i % 7 == 0) ? "" : testdata[i % num_testdata]);
+    if (i == num_short / 2)
+      fprintf(file, "%s\n", long_line);
+  }
+  fprintf(file, "Last");
+  fclose(file);
+  const int num_lines = num_short + 2;
+
+  for (int kind = 0; kind < 3; kind++)
+  {
+    for (int use_fd = 0; use_fd < 2; use_fd++)
+    {
+      CList list = (kind == 0) ? CL_new() : (kind == 1) ? CL_new_owning() : CL_new_unrolled();
+      CL_append(list, "First");
+
+      int appended;
+      if (use_fd)
+      {
+        fd = open(path, O_RDONLY);
+        appended = CL_append_lines_fd(list, fd);
+        close(fd);
+      }
+      else
+      {
+        file = fopen(path, "r");
+        appended = CL_append_lines(list, file);
+        fclose(file);
+      }
+
+      test_assert(appended == num_lines);
+      test_assert(CL_length(list) == num_lines + 1);
+      test_compare(CL_nth(list, 0), "First");
+      test_compare(CL_nth(list, -1), "Last");
+
+      CLCursor cursor = CL_cursor_begin(list);
+      CL_cursor_next(cursor);
+      for (int i = 0; i < num_short; i++)
+      {
+        test_compare(CL_cursor_get(cursor), (i % 7 == 0) ? "" : testdata[i % num_testdata]);
+        CL_cursor_next(cursor);
+        if (i == num_short / 2)
+        {
+          test_compare(CL_cursor_get(cursor), long_line);
+          CL_cursor_next(cursor);
+        }
+      }
+      CL_cursor_free(cursor);
+
+      CL_free(list);
+    }
+  }
+
+  // a pipe that returns short reads still fills whole blocks, rather
+  // than pinning a block per read; the blocks of a list in an arena go
+  // with the arena
+  CLArena arena = CL_arena_new(0);
+  for (int in_arena = 0; in_arena < 2; in_arena++)
+  {
+    int pipe_fds[2];
+    pthread_t writer;
+    test_assert(pipe(pipe_fds) == 0);
+    test_assert(pthread_create(&writer, NULL, _CL_pipe_writer, &pipe_fds[1]) == 0);
+
+    CList list = in_arena ? CL_new_in_arena(arena) : CL_new();
+    test_assert(CL_append_lines_fd(list, pipe_fds[0]) == PIPE_WRITES * PIPE_CHUNK / 8);
+    pthread_join(writer, NULL);
+    close(pipe_fds[0]);
+
+    test_compare(CL_nth(list, -1), "abcdefg");
+    int blocks = 0;
+    for (struct _cl_text_block *block = list->text; block != NULL; block = block->next)
+      blocks++;
+    test_assert(blocks == (in_arena ? 0 : 1));
+
+    CL_free(list);
+  }
+  CL_arena_free(arena);
+
+  // an empty file appends nothing, and a file ending in a newline has
+  // no empty last line
+  file = fopen(path, "w");
+  fclose(file);
+  CList list = CL_new();
+  file = fopen(path, "r");
+  test_assert(CL_append_lines(list, file) == 0);
+  fclose(file);
+
+  file = fopen(path, "w");
+  fprintf(file, "a\n\nb\n");
+  fclose(file);
+  file = fopen(path, "r");
+  test_assert(CL_append_lines(list, file) == 3);
+  fclose(file);
+  test_assert(CL_length(list) == 3);
+  test_compare(CL_nth(list, 1), "");
+  test_compare(CL_nth(list, 2), "b");
+
+  // reading a directory fails
+  fd = open("/tmp", O_RDONLY);
+  test_assert(CL_append_lines_fd(list, fd) == -1);
+  close(fd);
+  test_assert(CL_length(list) == 3);
+
+  CL_free(list);
+  remove(path);
+  free(long_line);
+
+  return 1;
+}
+
+/*
+ * Tests CL_get_stats
+ *
+ * Returns: 1 if all tests pass, 0 otherwise.
+ */
+int test_cl_stats()
+{
+  CLStats stats;
+  CList list = CL_new();
+
+  // without counters built in, everything reads as zero
+  if (!CL_get_stats(list, &stats))
+  {
+    CL_append(list, "One");
+    test_assert(!CL_get_stats(list, &stats));
+    test_assert(stats.calls[CL_API_APPEND] == 0 && stats.allocs == 0 && stats.peak_length == 0);
+    CL_free(list);
+    return 1;
+  }
+  test_assert(stats.calls[CL_API_APPEND] == 0 && stats.allocs == 0 && stats.peak_length == 0);
+
+  for (int i = 0; i < 100; i++)
+    CL_append(list, testdata[i % num_testdata]);
+
+  // searches from the head, then on from the finger; the ends are
+  // reached directly
+  CL_nth(list, 50);
+  CL_nth(list, 60);
+  CL_nth(list, 0);
+  CL_nth(list, -1);
+  CL_insert(list, "x", 30);
+  CL_get_stats(list, &stats);
+  test_assert(stats.calls[CL_API_APPEND] == 100);
+  test_assert(stats.traversed[CL_API_APPEND] == 0);
+  test_assert(stats.calls[CL_API_NTH] == 4);
+  test_assert(stats.traversed[CL_API_NTH] == 60);
+  test_assert(stats.calls[CL_API_INSERT] == 1);
+  test_assert(stats.traversed[CL_API_INSERT] == 29);
+  test_assert(stats.allocs == 101 && stats.frees == 0);
+  test_assert(stats.peak_length == 101);
+
+  // removing the first element pops it
+  CL_remove(list, 70);
+  CL_remove(list, 0);
+  CL_get_stats(list, &stats);
+  test_assert(stats.calls[CL_API_REMOVE] == 2);
+  test_assert(stats.calls[CL_API_POP] == 1);
+  test_assert(stats.traversed[CL_API_REMOVE] > 0);
+  test_assert(stats.frees == 2);
+  test_assert(stats.peak_length == 101);
+
+  CList sorted = CL_new();
+  for (int i = 0; i < num_testdata; i++)
+    CL_insert_sorted(sorted, testdata[i]);
+  CL_join(list, sorted);
+  CL_get_stats(sorted, &stats);
+  test_assert(stats.calls[CL_API_INSERT_SORTED] == num_testdata);
+  test_assert(stats.traversed[CL_API_INSERT_SORTED] > 0);
+  CL_get_stats(list, &stats);
+  test_assert(stats.calls[CL_API_JOIN] == 1);
+  test_assert(stats.peak_length == 99 + num_testdata);
+  CL_free(sorted);
+  CL_free(list);
+
+  // lists with another backend count calls and peak length
+  list = CL_new_concurrent();
+  for (int i = 0; i < 10; i++)
+    CL_push(list, testdata[i]);
+  while (CL_pop(list) != INVALID_RETURN)
+    ;
+  CL_get_stats(list, &stats);
+  test_assert(stats.calls[CL_API_PUSH] == 10);
+  test_assert(stats.calls[CL_API_POP] == 11);
+  test_assert(stats.peak_length == 10);
+  CL_free(list);
+
+  return 1;
+}
+
+/*
+ * Tests CL_validate, corrupting lists by reaching into their internals
+ *
+ * Returns: 1 if all tests pass, 0 otherwise.
+ */
+int test_cl_validate()
+{
+  CList lists[] = {CL_new(), CL_new_owning(), CL_new_unrolled(), CL_new_indexed(),
+                   CL_new_concurrent(), CL_new_concurrent_queue(), CL_new_locked(),
+                   CL_new_compact()};
+  const int num_lists = sizeof(lists) / sizeof(lists[0]);
+
+  for (int l = 0; l < num_lists; l++)
+  {
+    test_assert(CL_validate(lists[l]));
+    for (int i = 0; i < num_testdata; i++)
+      CL_append(lists[l], testdata[i]);
+    test_assert(CL_validate(lists[l]));
+
+    // a length that does not match the elements
+    lists[l]->length++;
+    test_assert(!CL_validate(lists[l]));
+    lists[l]->length -= 2;
+    test_assert(!CL_validate(lists[l]));
+    lists[l]->length++;
+    test_assert(CL_validate(lists[l]));
+  }
+
+  // a cycle, a wrong tail and a misplaced finger in a linked list
+  CList list = lists[0];
+  CL_nth(list, 5);
+  test_assert(CL_validate(list));
+
+  list->tail->next = list->head->next;
+  test_assert(!CL_validate(list));
+  list->tail->next = list->tail;
+  test_assert(!CL_validate(list));
+  list->tail->next = NULL;
+  test_assert(CL_validate(list));
+
+  struct _cl_node *tail = list->tail;
+  list->tail = list->head;
+  test_assert(!CL_validate(list));
+  list->tail = tail;
+
+  list->finger_pos++;
+  test_assert(!CL_validate(list));
+  list->finger_pos--;
+  test_assert(CL_validate(list));
+
+  for (int l = 0; l < num_lists; l++)
+    CL_free(lists[l]);
+
+  return 1;
+}
+
+/*
+ * CL_foreach64 callback: checks that positions arrive in order, and
+ * counts them
+ */
+void _CL_count_in_order(size_t pos, CListElementType element, void *cb_data)
+{
+  size_t *count = (size_t *)cb_data;
+
+  assert(pos == *count);
+  (*count)++;
+}
+
+/*
+ * Tests the 64-bit versions of the positional functions
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_64bit()
+{
+  CList lists[] = {CL_new(), CL_new_owning(), CL_new_unrolled(), CL_new_indexed(),
+                   CL_new_concurrent(), CL_new_concurrent_queue(), CL_new_locked(),
+                   CL_new_compact()};
+  const int num_lists = sizeof(lists) / sizeof(lists[0]);
+
+  for (int l = 0; l < num_lists; l++)
+  {
+    CList list = lists[l];
+    CList expected = CL_new();
+
+    // built with the 64-bit functions, checked with the int ones
+    for (int i = 0; i < num_testdata; i++)
+    {
+      test_assert(CL_insert64(list, testdata[i], i % 2 == 0 ? -1 : (ptrdiff_t)i / 2));
+      test_assert(CL_insert(expected, testdata[i], i % 2 == 0 ? -1 : i / 2));
+    }
+    test_assert(CL_length64(list) == (size_t)CL_length(expected));
+    for (int i = 0; i < num_testdata; i++)
+    {
+      test_compare(CL_nth64(list, i), CL_nth(expected, i));
+      test_compare(CL_nth64(list, (ptrdiff_t)i - num_testdata), CL_nth(expected, i));
+    }
+
+    // the same bounds as the int functions
+    ptrdiff_t length = (ptrdiff_t)CL_length64(list);
+    test_assert(CL_nth64(list, length) == INVALID_RETURN);
+    test_assert(CL_nth64(list, -length - 1) == INVALID_RETURN);
+    test_assert(!CL_insert64(list, "x", length + 1));
+    test_assert(!CL_insert64(list, "x", -length - 2));
+    test_assert(CL_remove64(list, length) == INVALID_RETURN);
+    test_assert(CL_remove64(list, -length - 1) == INVALID_RETURN);
+    test_assert(CL_length64(list) == (size_t)length);
+
+    test_compare(CL_remove64(list, -1), CL_remove(expected, -1));
+    test_compare(CL_remove64(list, 3), CL_remove(expected, 3));
+    test_compare(CL_remove64(list, -5), CL_remove(expected, -5));
+
+    size_t count = 0;
+    CL_foreach64(list, _CL_count_in_order, &count);
+    test_assert(count == CL_length64(list));
+
+    // insert_sorted64 reports the same positions as insert_sorted
+    CL_sort(list, NULL);
+    CL_sort(expected, NULL);
+    for (int i = 0; i < 20; i++)
+    {
+      const char *element = testdata[rand() % num_testdata];
+      test_assert(CL_insert_sorted64(list, element) == (size_t)CL_insert_sorted(expected, element));
+    }
+    for (int i = 0; i < CL_length(expected); i++)
+      test_compare(CL_nth(list, i), CL_nth(expected, i));
+
+    CL_free(expected);
+  }
+
+  for (int l = 0; l < num_lists; l++)
+    CL_free(lists[l]);
+
+  return 1;
+}
+
+/*
+ * Tests CL_compact and CL_fragmentation on lists that have been
+ * scattered by insertions and removals at random positions
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_compact_layout()
+{
+  CLNodePool pool = CL_pool_new(0);
+  CLArena arena = CL_arena_new(0);
+
+  // a malloc list, one with a pool of its own (its creator's reference
+  // dropped), one sharing a pool, one in an arena, and a compact one
+  CLNodePool own_pool = CL_pool_new(0);
+  CList private_pool = CL_new_with_pool(own_pool);
+  CL_pool_free(own_pool);
+  CL_append_array(private_pool, testdata, num_testdata);
+  CList lists[] = {CL_new(), private_pool, CL_new_with_pool(pool), CL_new_in_arena(arena),
+                   CL_new_compact()};
+  const int num_lists = sizeof(lists) / sizeof(lists[0]);
+
+  for (int l = 0; l < num_lists; l++)
+  {
+    CList list = lists[l];
+    CList expected = CL_new();
+    if (l == 1)
+      CL_append_array(expected, testdata, num_testdata);
+
+    unsigned int seed = 2025 + l;
+    for (int i = 0; i < 3000; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      int pos = (int)((seed >> 8) % (CL_length(expected) + 1));
+      if (i % 3 == 2 && pos < CL_length(expected))
+      {
+        test_compare(CL_remove(list, pos), CL_remove(expected, pos));
+      }
+      else
+      {
+        CL_insert(list, testdata[i % num_testdata], pos);
+        CL_insert(expected, testdata[i % num_testdata], pos);
+      }
+    }
+    test_assert(CL_fragmentation(list) > 0.0);
+
+    // leave a finger in the middle, which must survive the move
+    int middle = CL_length(list) / 2;
+    test_compare(CL_nth(list, middle), CL_nth(expected, middle));
+
+    CL_compact(list);
+    test_assert(CL_validate(list));
+    test_assert(CL_fragmentation(list) == 0.0);
+    test_assert(_CL_same_contents(list, expected));
+    test_compare(CL_nth(list, middle + 1), CL_nth(expected, middle + 1));
+
+    // the compacted list carries on as before
+    for (int i = 0; i < 100; i++)
+    {
+      CL_insert(list, "after", 3 * i);
+      CL_insert(expected, "after", 3 * i);
+      test_compare(CL_remove(list, -i - 1), CL_remove(expected, -i - 1));
+    }
+    test_assert(CL_validate(list));
+    test_assert(_CL_same_contents(list, expected));
+
+    CL_free(expected);
+  }
+
+  // lists with a pool or arena to themselves give their old nodes back
+  CL_compact(lists[2]);
+  CL_compact(lists[2]);
+  CLNodePoolStats stats;
+  CL_pool_stats(pool, &stats);
+  test_assert(stats.in_use == (size_t)CL_length(lists[2]));
+
+  for (int l = 0; l < num_lists; l++)
+    CL_free(lists[l]);
+  CL_pool_free(pool);
+  CL_arena_free(arena);
+
+  // owning lists, empty lists and other backends are left as they are
+  CList owning = CL_new_owning();
+  CList unrolled = CL_new_unrolled();
+  CList empty = CL_new();
+  for (int i = 0; i < num_testdata; i++)
+  {
+    CL_append(owning, testdata[i]);
+    CL_append(unrolled, testdata[i]);
+  }
+  CListElementType first = CL_nth(owning, 0);
+  CL_compact(owning);
+  CL_compact(unrolled);
+  CL_compact(empty);
+  test_assert(CL_nth(owning, 0) == first);
+  test_assert(CL_fragmentation(owning) == 1.0);
+  test_assert(CL_fragmentation(unrolled) == 0.0);
+  test_assert(CL_fragmentation(empty) == 0.0);
+  test_assert(CL_validate(owning) && CL_validate(unrolled) && CL_validate(empty));
+  for (int i = 0; i < num_testdata; i++)
+    test_compare(CL_nth(unrolled, i), testdata[i]);
+
+  CL_free(owning);
+  CL_free(unrolled);
+  CL_free(empty);
+
+  return 1;
+}
+
+/*
+ * A demonstration of how to use a CList, which also doubles as a
+ * test case.
+ *
+ * Returns: 1 if all tests pass, 0 otherwise.
+ */
+int sample_clist_usage()
+{
+  CList list = CL_new();
+
+  // new lists have length 0
+  test_assert(CL_length(list) == 0);
+
+  CL_push(list, "alpha");   // push 'alpha' onto front of list
+  CL_push(list, "bravo");   // push 'bravo' onto front of list
+  CL_push(list, "charlie"); // push 'charlie' onto front of list
+
+  // list is now charlie, bravo, alpha
+  CL_print(list); // print out the list: charlie, bravo, alpha
+  test_assert(CL_length(list) == 3);
+
+  // pop the element off the front of the list, which should be 'charlie'
+  test_compare(CL_pop(list), "charlie");
+  test_assert(CL_length(list) == 2);
+
+  CL_insert(list, "delta", 2);    // insert 'delta' at position 2
+  CL_append(list, "echo");        // append 'echo' at end of list
+  CL_insert(list, "foxtrot", -2); // insert 'foxtrot' one before end
+
+  // list is now: bravo, alpha, delta, foxtrot, echo
+  test_assert(CL_length(list) == 5);
+
+  // retrieve the 3rd element, numbering from 0, so it should be foxtrot
+  test_compare(CL_nth(list, 3), "foxtrot");
+
+  // list hasn't changed
+  test_assert(CL_length(list) == 5);
+
+  // now REMOVE the third element
+  test_compare(CL_remove(list, 3), "foxtrot");
+  test_assert(CL_length(list) == 4);
+
+  // list is now: bravo, alpha, delta, echo
+
+  // make a copy of the list
+  CList list_copy = CL_copy(list);
+
+  test_assert(CL_length(list_copy) == 4);
+
+  // reverse the copy, so it is now echo, delta, alpha, bravo
+  CL_reverse(list_copy);
+
+  // remove the first item from the copy
+  test_compare(CL_remove(list_copy, 0), "echo");
+  test_assert(CL_length(list_copy) == 3);
+
+  // original list should be unchanged
+  test_assert(CL_length(list) == 4);
+
+  // join the two lists; note this operation empties list_copy
+  CL_join(list, list_copy);
+
+  // list is now: bravo, alpha, delta, echo, delta, alpha, bravo
+  // list_copy should be empty
+  test_assert(CL_length(list) == 7);
+  test_compare(CL_nth(list, 3), "echo");
+  test_assert(CL_length(list_copy) == 0);
+
+  // Lists must be destroyed
+  CL_free(list);
+  CL_free(list_copy);
+
+  return 1;
+}
+
+int main()
+{
+  int passed = 0;
+  int num_tests = 0;
+
+  num_tests++;
+  passed += test_cl_push_pop();
+  num_tests++;
+  passed += test_cl_append();
+  num_tests++;
+  passed += test_cl_nth();
+
+  num_tests++;
+  passed += test_cl_insert();
+
+  num_tests++;
+  passed += test_cl_remove();
+
+  num_tests++;
+  passed += sample_clist_usage();
+
+  num_tests++;
+  passed += test_cl_copy();
+
+  num_tests++;
+  passed += test_cl_insert_sorted();
+
+  num_tests++;
+  passed += test_cl_join();
+
+  num_tests++;
+  passed += test_cl_reverse();
+
+  num_tests++;
+  passed += test_cl_foreach();
+
+  num_tests++;
+  passed += test_cl_tail_ops();
+
+  num_tests++;
+  passed += test_cl_pool();
+
+  num_tests++;
+  passed += test_cl_arena();
+
+  num_tests++;
+  passed += test_cl_unrolled();
+
+  num_tests++;
+  passed += test_cl_indexed();
+
+  num_tests++;
+  passed += test_cl_compact();
+
+  num_tests++;
+  passed += test_cl_cursor();
+
+  num_tests++;
+  passed += test_cl_finger();
+
+  num_tests++;
+  passed += test_cl_array();
+
+  num_tests++;
+  passed += test_cl_sort();
+
+  num_tests++;
+  passed += test_cl_sort_parallel();
+
+  num_tests++;
+  passed += test_cl_sort_prefixes();
+
+  num_tests++;
+  passed += test_cl_generic();
+
+  num_tests++;
+  passed += test_cl_owning();
+
+  num_tests++;
+  passed += test_cl_concurrent();
+
+  num_tests++;
+  passed += test_cl_concurrent_queue();
+
+  num_tests++;
+  passed += test_cl_locked();
+
+  num_tests++;
+  passed += test_cl_parallel_foreach();
+
+  num_tests++;
+  passed += test_cl_snapshot();
+
+  num_tests++;
+  passed += test_cl_append_lines();
+
+  num_tests++;
+  passed += test_cl_stats();
+
+  num_tests++;
+  passed += test_cl_validate();
+
+  num_tests++;
+  passed += test_cl_64bit();
+
+  num_tests++;
+  passed += test_cl_compact_layout();
 
   printf("Passed %d/%d test cases\n", passed, num_tests);
   fflush(stdout);
@@ -0,0 +1,506 @@
+/*
+ * clist_unrolled.c
+ *
+ * Unrolled linked list backend for CList. Each node (a "chunk") holds
+ * a small array of elements and is sized to a few cache lines, so that
+ * walking to a position reads one cache line per chunk rather than one
+ * per element, and the cost of the links is shared by all the elements
+ * in a chunk.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include "clist.h"
+#include "clist_internal.h"
+
+// Size and alignment of a chunk, in bytes
+#define CL_CACHE_LINE 64
+#define CL_UNROLLED_CHUNK_BYTES (4 * CL_CACHE_LINE)
+
+struct _cl_chunk
+{
+  struct _cl_chunk *next;
+  struct _cl_chunk *prev;
+  int count; // elements in use, always at least 1 while linked
+  CListElementType elements[];
+};
+
+// Number of elements that fit in one chunk
+#define CHUNK_CAPACITY                                          \
+  ((int)((CL_UNROLLED_CHUNK_BYTES - sizeof(struct _cl_chunk)) / \
+         sizeof(CListElementType)))
+
+// A chunk that falls below this many elements after a removal is
+// merged with a neighbour, when the two fit in a single chunk
+#define CHUNK_MIN (CHUNK_CAPACITY / 2)
+
+struct _cl_unrolled
+{
+  struct _cl_chunk *head;
+  struct _cl_chunk *tail;
+};
+
+#define UNROLLED(list) ((struct _cl_unrolled *)(list)->impl)
+
+/*
+ * Allocate a new, empty, cache-line aligned chunk
+ *
+ * Parameters: None
+ *
+ * Returns: The new chunk; its links are not initialized
+ */
+static struct _cl_chunk *
+_CLU_new_chunk()
+{
+  struct _cl_chunk *chunk = (struct _cl_chunk *)aligned_alloc(CL_CACHE_LINE, CL_UNROLLED_CHUNK_BYTES);
+  assert(chunk);
+
+  chunk->count = 0;
+
+  return chunk;
+}
+
+/*
+ * Link chunk into the list directly after prev
+ *
+ * Parameters:
+ *   u      The list's backend state
+ *   prev   The chunk to link after, or NULL to link at the head
+ *   chunk  The chunk to link in
+ *
+ * Returns: None
+ */
+static void
+_CLU_link_after(struct _cl_unrolled *u, struct _cl_chunk *prev, struct _cl_chunk *chunk)
+{
+  struct _cl_chunk *next = (prev == NULL) ? u->head : prev->next;
+
+  chunk->prev = prev;
+  chunk->next = next;
+
+  if (prev == NULL)
+    u->head = chunk;
+  else
+    prev->next = chunk;
+
+  if (next == NULL)
+    u->tail = chunk;
+  else
+    next->prev = chunk;
+}
+
+/*
+ * Unlink chunk from the list and deallocate it
+ *
+ * Parameters:
+ *   u      The list's backend state
+ *   chunk  The chunk to remove
+ *
+ * Returns: None
+ */
+static void
+_CLU_free_chunk(struct _cl_unrolled *u, struct _cl_chunk *chunk)
+{
+  if (chunk->prev == NULL)
+    u->head = chunk->next;
+  else
+    chunk->prev->next = chunk->next;
+
+  if (chunk->next == NULL)
+    u->tail = chunk->prev;
+  else
+    chunk->next->prev = chunk->prev;
+
+  free(chunk);
+}
+
+/*
+ * Find the chunk holding a given position, walking from whichever end
+ * of the list is closer
+ *
+ * Parameters:
+ *   list     The list
+ *   pos      Position to find, in the range [0, length-1]
+ *   offset   Set to the index of pos within the returned chunk
+ *
+ * Returns: The chunk holding position pos
+ */
+static struct _cl_chunk *
+_CLU_find(CList list, ptrdiff_t pos, int *offset)
+{
+  struct _cl_unrolled *u = UNROLLED(list);
+  struct _cl_chunk *chunk;
+
+  if (pos < list->length / 2)
+  {
+    chunk = u->head;
+    while (pos >= chunk->count)
+    {
+      pos -= chunk->count;
+      chunk = chunk->next;
+    }
+    *offset = (int)pos;
+  }
+  else
+  {
+    // start is the position of the first element of chunk
+    chunk = u->tail;
+    ptrdiff_t start = list->length - chunk->count;
+    while (pos < start)
+    {
+      chunk = chunk->prev;
+      start -= chunk->count;
+    }
+    *offset = (int)(pos - start);
+  }
+
+  return chunk;
+}
+
+/*
+ * Insert element before index offset of chunk, splitting the chunk in
+ * two if it is full
+ *
+ * Parameters:
+ *   list     The list
+ *   chunk    The chunk to insert into
+ *   offset   Index within chunk, in the range [0, chunk->count]
+ *   element  The element to insert
+ *
+ * Returns: None
+ */
+static void
+_CLU_insert_at(CList list, struct _cl_chunk *chunk, int offset, CListElementType element)
+{
+  if (chunk->count == CHUNK_CAPACITY)
+  {
+    // move the upper half of the chunk into a new chunk after it
+    struct _cl_chunk *split = _CLU_new_chunk();
+    int keep = CHUNK_CAPACITY / 2;
+
+    split->count = chunk->count - keep;
+    memcpy(split->elements, chunk->elements + keep, split->count * sizeof(CListElementType));
+    chunk->count = keep;
+    _CLU_link_after(UNROLLED(list), chunk, split);
+
+    if (offset > keep)
+    {
+      chunk = split;
+      offset -= keep;
+    }
+  }
+
+  memmove(chunk->elements + offset + 1, chunk->elements + offset,
+          (chunk->count - offset) * sizeof(CListElementType));
+  chunk->elements[offset] = element;
+  chunk->count++;
+  list->length++;
+}
+
+/*
+ * Remove and return the element at index offset of chunk, then free
+ * the chunk if it is empty or merge it with a neighbour if it has
+ * become sparse
+ *
+ * Parameters:
+ *   list     The list
+ *   chunk    The chunk to remove from
+ *   offset   Index within chunk, in the range [0, chunk->count-1]
+ *
+ * Returns: The removed element
+ */
+static CListElementType
+_CLU_remove_at(CList list, struct _cl_chunk *chunk, int offset)
+{
+  struct _cl_unrolled *u = UNROLLED(list);
+  CListElementType element = chunk->elements[offset];
+
+  memmove(chunk->elements + offset, chunk->elements + offset + 1,
+          (chunk->count - offset - 1) * sizeof(CListElementType));
+  chunk->count--;
+  list->length--;
+
+  if (chunk->count == 0)
+    _CLU_free_chunk(u, chunk);
+
+  else if (chunk->count < CHUNK_MIN)
+  {
+    // merge into whichever neighbour has room, so the number of
+    // chunks (and the cache lines walked) stays proportional to length
+    struct _cl_chunk *into = NULL, *from = NULL;
+    if (chunk->next != NULL && chunk->count + chunk->next->count <= CHUNK_CAPACITY)
+    {
+      into = chunk;
+      from = chunk->next;
+    }
+    else if (chunk->prev != NULL && chunk->prev->count + chunk->count <= CHUNK_CAPACITY)
+    {
+      into = chunk->prev;
+      from = chunk;
+    }
+
+    if (into != NULL)
+    {
+      memcpy(into->elements + into->count, from->elements, from->count * sizeof(CListElementType));
+      into->count += from->count;
+      _CLU_free_chunk(u, from);
+    }
+  }
+
+  return element;
+}
+
+/*
+ * The operations below implement struct _cl_ops for unrolled lists;
+ * see clist_internal.h
+ */
+
+static void
+_CLU_free(CList list)
+{
+  struct _cl_unrolled *u = UNROLLED(list);
+
+  struct _cl_chunk *chunk = u->head;
+  while (chunk != NULL)
+  {
+    struct _cl_chunk *next_chunk = chunk->next;
+    free(chunk);
+    chunk = next_chunk;
+  }
+
+  free(u);
+}
+
+static bool
+_CLU_check(CList list)
+{
+  struct _cl_unrolled *u = UNROLLED(list);
+
+  // every chunk holds an element, so a cycle soon takes len past the
+  // list's length
+  ptrdiff_t len = 0;
+  struct _cl_chunk *last = NULL;
+  for (struct _cl_chunk *chunk = u->head; chunk != NULL; chunk = chunk->next)
+  {
+    if (chunk->prev != last || chunk->count <= 0 || chunk->count > CHUNK_CAPACITY)
+      return false;
+    len += chunk->count;
+    if (len > list->length)
+      return false;
+    last = chunk;
+  }
+
+  return len == list->length && last == u->tail;
+}
+
+static void
+_CLU_push(CList list, CListElementType element)
+{
+  struct _cl_unrolled *u = UNROLLED(list);
+
+  // like appends, pushes start a new chunk rather than splitting a full
+  // one, so a list built by pushing has every chunk full
+  if (u->head == NULL || u->head->count == CHUNK_CAPACITY)
+    _CLU_link_after(u, NULL, _CLU_new_chunk());
+
+  _CLU_insert_at(list, u->head, 0, element);
+}
+
+static CListElementType
+_CLU_pop(CList list)
+{
+  return _CLU_remove_at(list, UNROLLED(list)->head, 0);
+}
+
+static void
+_CLU_append(CList list, CListElementType element)
+{
+  struct _cl_unrolled *u = UNROLLED(list);
+
+  // appends fill the tail chunk and then start a new one, so a list
+  // built by appending has every chunk full
+  if (u->tail == NULL || u->tail->count == CHUNK_CAPACITY)
+    _CLU_link_after(u, u->tail, _CLU_new_chunk());
+
+  u->tail->elements[u->tail->count++] = element;
+  list->length++;
+}
+
+static CListElementType
+_CLU_nth(CList list, ptrdiff_t pos)
+{
+  int offset;
+  struct _cl_chunk *chunk = _CLU_find(list, pos, &offset);
+
+  return chunk->elements[offset];
+}
+
+static bool
+_CLU_insert(CList list, CListElementType element, ptrdiff_t pos)
+{
+  if (pos == list->length)
+  {
+    _CLU_append(list, element);
+    return true;
+  }
+
+  int offset;
+  struct _cl_chunk *chunk = _CLU_find(list, pos, &offset);
+  _CLU_insert_at(list, chunk, offset, element);
+
+  return true;
+}
+
+static CListElementType
+_CLU_remove(CList list, ptrdiff_t pos)
+{
+  int offset;
+  struct _cl_chunk *chunk = _CLU_find(list, pos, &offset);
+
+  return _CLU_remove_at(list, chunk, offset);
+}
+
+static CList
+_CLU_copy(CList list)
+{
+  CList list_copy = CL_new_unrolled();
+
+  for (struct _cl_chunk *chunk = UNROLLED(list)->head; chunk != NULL; chunk = chunk->next)
+    for (int i = 0; i < chunk->count; i++)
+      _CLU_append(list_copy, chunk->elements[i]);
+
+  return list_copy;
+}
+
+static ptrdiff_t
+_CLU_insert_sorted(CList list, CListElementType element)
+{
+  ptrdiff_t position = 0;
+
+  // skip whole chunks whose last element sorts before element; only
+  // one element per skipped chunk is compared
+  for (struct _cl_chunk *chunk = UNROLLED(list)->head; chunk != NULL; chunk = chunk->next)
+  {
+    if (strcmp(chunk->elements[chunk->count - 1], element) < 0)
+    {
+      position += chunk->count;
+      continue;
+    }
+
+    // binary search for the first element that is greater than or
+    // equal to the element we are inserting
+    int lo = 0, hi = chunk->count - 1;
+    while (lo < hi)
+    {
+      int mid = (lo + hi) / 2;
+      if (strcmp(chunk->elements[mid], element) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+    _CLU_insert_at(list, chunk, lo, element);
+    return position + lo;
+  }
+
+  // every element sorts before the new one
+  _CLU_append(list, element);
+  return list->length - 1;
+}
+
+static void
+_CLU_join(CList list1, CList list2)
+{
+  struct _cl_unrolled *u1 = UNROLLED(list1);
+  struct _cl_unrolled *u2 = UNROLLED(list2);
+
+  if (u1->head == NULL)
+    u1->head = u2->head;
+  else
+  {
+    u1->tail->next = u2->head;
+    u2->head->prev = u1->tail;
+  }
+
+  u1->tail = u2->tail;
+  list1->length += list2->length;
+
+  u2->head = NULL;
+  u2->tail = NULL;
+  list2->length = 0;
+}
+
+static void
+_CLU_reverse(CList list)
+{
+  struct _cl_unrolled *u = UNROLLED(list);
+
+  struct _cl_chunk *chunk = u->head;
+  while (chunk != NULL)
+  {
+    struct _cl_chunk *next_chunk = chunk->next;
+
+    // reverse the elements within the chunk, then its links
+    for (int i = 0, j = chunk->count - 1; i < j; i++, j--)
+    {
+      CListElementType tmp = chunk->elements[i];
+      chunk->elements[i] = chunk->elements[j];
+      chunk->elements[j] = tmp;
+    }
+    chunk->next = chunk->prev;
+    chunk->prev = next_chunk;
+
+    chunk = next_chunk;
+  }
+
+  struct _cl_chunk *old_head = u->head;
+  u->head = u->tail;
+  u->tail = old_head;
+}
+
+static void
+_CLU_foreach(CList list, CL_foreach64_callback callback, void *cb_data)
+{
+  size_t position = 0;
+
+  for (struct _cl_chunk *chunk = UNROLLED(list)->head; chunk != NULL; chunk = chunk->next)
+    for (int i = 0; i < chunk->count; i++)
+      callback(position++, chunk->elements[i], cb_data);
+}
+
+const struct _cl_ops _CL_unrolled_ops = {
+    .free = _CLU_free,
+    .check = _CLU_check,
+    .push = _CLU_push,
+    .pop = _CLU_pop,
+    .append = _CLU_append,
+    .nth = _CLU_nth,
+    .insert = _CLU_insert,
+    .remove = _CLU_remove,
+    .copy = _CLU_copy,
+    .insert_sorted = _CLU_insert_sorted,
+    .join = _CLU_join,
+    .reverse = _CLU_reverse,
+    .foreach = _CLU_foreach,
+};
+
+// Documented in .h file
+CList CL_new_unrolled()
+{
+  CList list = CL_new();
+
+  struct _cl_unrolled *u = (struct _cl_unrolled *)malloc(sizeof(struct _cl_unrolled));
+  assert(u);
+
+  u->head = NULL;
+  u->tail = NULL;
+
+  list->ops = &_CL_unrolled_ops;
+  list->impl = u;
+
+  return list;
+}
@@ -0,0 +1,249 @@
+/*
+ * clist_workers.c
+ *
+ * A pool of worker threads shared by the parallel CList functions.
+ * The threads are started the first time they are needed and then
+ * kept for reuse, so a parallel call costs a wakeup rather than a
+ * thread creation per worker.
+ *
+ * A job is a number of tasks, identified by index. They are dealt out
+ * in contiguous blocks, one block per participating thread (the
+ * calling thread takes part too). Each thread works through its own
+ * block from the front; a thread that runs out steals tasks from the
+ * back of another thread's block, so threads whose tasks turn out to
+ * be quick help those whose tasks are slow.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "clist.h"
+#include "clist_internal.h"
+
+// Upper limit on the number of threads taking part in a job
+#define CLW_MAX_THREADS 64
+
+// Tasks not yet started from one thread's block: [next, end)
+struct _cl_task_block
+{
+  pthread_mutex_t lock;
+  int next;
+  int end;
+};
+
+struct _cl_job
+{
+  _CL_task_fn fn;
+  void *data;
+  int num_threads;    // threads taking part, including the caller
+  int remaining;      // tasks not yet finished
+  struct _cl_task_block blocks[CLW_MAX_THREADS];
+};
+
+struct _cl_workers
+{
+  pthread_mutex_t run_lock; // held by the thread whose job is running
+  pthread_mutex_t lock;     // guards everything below
+  pthread_cond_t wake;      // signalled when a job starts
+  pthread_cond_t done;      // signalled when a worker leaves a job
+  int num_workers;          // threads started so far
+  struct _cl_job *job;      // the running job, or NULL
+  unsigned long generation; // number of jobs started so far
+  int busy;                 // workers inside the running job
+};
+
+static struct _cl_workers _CL_workers = {
+    .run_lock = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+// Set in threads that are running a task, so that a task that starts
+// a job of its own runs it itself rather than waiting for the pool
+static __thread bool _CL_in_task;
+
+/*
+ * Take the next task of a job for a thread: the first task left in
+ * its own block, or else the last task left in another's
+ *
+ * Parameters:
+ *   job    The job
+ *   self   The thread's number in the job
+ *
+ * Returns: The task index, or -1 if no task is left to start
+ */
+static int
+_CLW_take_task(struct _cl_job *job, int self)
+{
+  struct _cl_task_block *own = &job->blocks[self];
+  int task = -1;
+
+  pthread_mutex_lock(&own->lock);
+  if (own->next < own->end)
+    task = own->next++;
+  pthread_mutex_unlock(&own->lock);
+
+  for (int i = 1; task < 0 && i < job->num_threads; i++)
+  {
+    struct _cl_task_block *victim = &job->blocks[(self + i) % job->num_threads];
+
+    pthread_mutex_lock(&victim->lock);
+    if (victim->next < victim->end)
+      task = --victim->end;
+    pthread_mutex_unlock(&victim->lock);
+  }
+
+  return task;
+}
+
+/*
+ * Run tasks of a job until none is left to start
+ *
+ * Parameters:
+ *   job    The job
+ *   self   The thread's number in the job
+ *
+ * Returns: None
+ */
+static void
+_CLW_work(struct _cl_job *job, int self)
+{
+  _CL_in_task = true;
+
+  int task;
+  while ((task = _CLW_take_task(job, self)) >= 0)
+  {
+    job->fn(job->data, task);
+    __atomic_fetch_sub(&job->remaining, 1, __ATOMIC_RELEASE);
+  }
+
+  _CL_in_task = false;
+}
+
+/*
+ * Body of a pool thread: wait for a job, take part in it if it wants
+ * this thread, and repeat
+ *
+ * Parameters:
+ *   arg    The thread's number in any job, from 1
+ *
+ * Returns: Never
+ */
+static void *
+_CLW_thread(void *arg)
+{
+  int self = (int)(intptr_t)arg;
+  struct _cl_workers *w = &_CL_workers;
+  unsigned long seen = 0;
+
+  pthread_mutex_lock(&w->lock);
+  for (;;)
+  {
+    while (w->job == NULL || w->generation == seen)
+      pthread_cond_wait(&w->wake, &w->lock);
+    seen = w->generation;
+
+    struct _cl_job *job = w->job;
+    if (self >= job->num_threads)
+      continue;
+
+    w->busy++;
+    pthread_mutex_unlock(&w->lock);
+
+    _CLW_work(job, self);
+
+    pthread_mutex_lock(&w->lock);
+    w->busy--;
+    pthread_cond_broadcast(&w->done);
+  }
+
+  return NULL;
+}
+
+// Documented in clist_internal.h
+int _CL_workers_threads(int num_threads)
+{
+  if (num_threads <= 0)
+    num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (num_threads < 1)
+    num_threads = 1;
+  if (num_threads > CLW_MAX_THREADS)
+    num_threads = CLW_MAX_THREADS;
+
+  return num_threads;
+}
+
+// Documented in clist_internal.h
+void _CL_workers_run(int num_threads, int num_tasks, _CL_task_fn fn, void *data)
+{
+  num_threads = _CL_workers_threads(num_threads);
+  if (num_threads > num_tasks)
+    num_threads = num_tasks;
+
+  // a job started from within a task, or one with a single thread,
+  // runs in the calling thread
+  if (num_threads <= 1 || _CL_in_task)
+  {
+    for (int task = 0; task < num_tasks; task++)
+      fn(data, task);
+    return;
+  }
+
+  struct _cl_workers *w = &_CL_workers;
+  pthread_mutex_lock(&w->run_lock);
+
+  pthread_mutex_lock(&w->lock);
+
+  // start any threads this job needs that are not running yet; if no
+  // more can be started, the job makes do with those there are
+  while (w->num_workers < num_threads - 1)
+  {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, _CLW_thread, (void *)(intptr_t)(w->num_workers + 1)) != 0)
+    {
+      num_threads = w->num_workers + 1;
+      break;
+    }
+    pthread_detach(thread);
+    w->num_workers++;
+  }
+
+  struct _cl_job job;
+  job.fn = fn;
+  job.data = data;
+  job.num_threads = num_threads;
+  job.remaining = num_tasks;
+  for (int t = 0; t < num_threads; t++)
+  {
+    pthread_mutex_init(&job.blocks[t].lock, NULL);
+    job.blocks[t].next = (int)((long)num_tasks * t / num_threads);
+    job.blocks[t].end = (int)((long)num_tasks * (t + 1) / num_threads);
+  }
+
+  w->job = &job;
+  w->generation++;
+  pthread_cond_broadcast(&w->wake);
+  pthread_mutex_unlock(&w->lock);
+
+  _CLW_work(&job, 0);
+
+  // every task has been started once our own work runs out; wait until
+  // they have all finished and no worker is still looking at the job
+  pthread_mutex_lock(&w->lock);
+  while (__atomic_load_n(&job.remaining, __ATOMIC_ACQUIRE) > 0 || w->busy > 0)
+    pthread_cond_wait(&w->done, &w->lock);
+  w->job = NULL;
+  pthread_mutex_unlock(&w->lock);
+
+  for (int t = 0; t < num_threads; t++)
+    pthread_mutex_destroy(&job.blocks[t].lock);
+
+  pthread_mutex_unlock(&w->run_lock);
+}